@@ -1255,6 +1255,19 @@ int QE_BindEvent(QE_BindingTable bindingTable, QE_Event *eventPtr)
 	return BindEventWrapper(bindingTable, eventPtr, NULL);
 }
 
+/* Return 1 if any object has a binding for the given event type and
+ * detail (0 for the event itself), so callers can skip gathering the
+ * information for an event nobody is listening to. */
+int QE_BindingExists(QE_BindingTable bindingTable, int eventType, int detail)
+{
+	BindingTable *bindPtr = (BindingTable *) bindingTable;
+	PatternTableKey key;
+
+	key.type = eventType;
+	key.detail = detail;
+	return Tcl_FindHashEntry(&bindPtr->patternTable, (char *) &key) != NULL;
+}
+
 static char *GetField(char *p, char *copy, int size)
 {
 	int ch = *p;
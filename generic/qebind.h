@@ -50,6 +50,8 @@ extern int QE_GetAllBindings(QE_BindingTable bindingTable,
 extern int QE_GetEventNames(QE_BindingTable bindingTable);
 extern int QE_GetDetailNames(QE_BindingTable bindingTable, char *eventName);
 extern int QE_BindEvent(QE_BindingTable bindingTable, QE_Event *eventPtr);
+extern int QE_BindingExists(QE_BindingTable bindingTable, int eventType,
+	int detail);
 extern void QE_ExpandDouble(double number, Tcl_DString *result);
 extern void QE_ExpandNumber(long number, Tcl_DString *result);
 extern void QE_ExpandString(char *string, Tcl_DString *result);
@@ -122,6 +122,12 @@ struct TreeColumn_
     int weight;			/* -weight */
 #endif
     TreeColumnDInfo dInfo;	/* Display info. */
+    Pixmap hdrPixmap;		/* Cached picture of the header, or None. */
+    int hdrWidth;		/* Size of hdrPixmap. */
+    int hdrHeight;
+    int hdrState;		/* Column_MakeState() and -arrow when */
+    int hdrArrow;		/* hdrPixmap was drawn. */
+    int hdrValid;		/* FALSE if hdrPixmap must be redrawn. */
 };
 
 #ifdef UNIFORM_GROUP
@@ -650,6 +656,7 @@ ImageChangedProc(
     tree->headerHeight = -1;
     tree->widthOfColumns = -1;
     tree->widthOfColumnsLeft = tree->widthOfColumnsRight = -1;
+    column->hdrValid = FALSE;
     Tree_DInfoChanged(tree, DINFO_CHECK_COLUMN_WIDTH | DINFO_DRAW_HEADER);
 }
 
@@ -2301,6 +2308,9 @@ Column_Config(
     if (mask & COLU_CONF_RANGES)
 	Tree_DInfoChanged(tree, DINFO_REDO_RANGES);
 
+    /* Any option may change the appearance of the header. */
+    column->hdrValid = FALSE;
+
     /* Redraw everything */
     if (mask & (COLU_CONF_TWIDTH | COLU_CONF_NWIDTH | COLU_CONF_NHEIGHT)) {
 	tree->widthOfColumns = -1;
@@ -2398,6 +2408,8 @@ Column_Free(
 	Tk_FreeImage(column->image);
     if (column->textLayout != NULL)
 	TextLayout_Free(column->textLayout);
+    if (column->hdrPixmap != None)
+	Tk_FreePixmap(tree->display, column->hdrPixmap);
     TreeDisplay_FreeColumnDInfo(tree, column);
     Tk_FreeConfigOptions((char *) column, column->optionTable, tree->tkwin);
     WFREE(column, TreeColumn_);
@@ -2622,7 +2634,7 @@ Column_UpdateTextLayout(
     if (wrap == TEXT_WRAP_WORD)
 	flags |= TK_WHOLE_WORDS;
 
-    column->textLayout = TextLayout_Compute(tkfont, text,
+    column->textLayout = TextLayout_Compute(column->tree, tkfont, text,
 	    Tcl_NumUtfChars(text, textLen), width, justify, maxLines, flags);
 }
 
@@ -2851,9 +2863,9 @@ Column_DoLayout(
 	    } else {
 		partText.width = widthForText;
 		partText.height = layout->fm.linespace;
-		layout->bytesThatFit = Tree_Ellipsis(layout->tkfont,
-			column->text, column->textLen, &partText.width,
-			"...", FALSE);
+		layout->bytesThatFit = Tree_Ellipsis(column->tree,
+			layout->tkfont, column->text, column->textLen,
+			&partText.width, "...", FALSE);
 	    }
 	    parts[n] = &partText;
 	    padList[n] = MAX(partText.padX[PAD_TOP_LEFT], padList[n]);
@@ -4638,6 +4650,81 @@ Column_Draw(
 		x, y, width, height, column->borderWidth, relief);
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * Column_DrawCached --
+ *
+ *	Draw the header for a column by copying from a pixmap holding
+ *	the last picture of the header. The pixmap is only redrawn if
+ *	the size, state or -arrow of the column changed, or if the
+ *	column or widget was reconfigured.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Stuff is drawn in a drawable. A pixmap may be allocated.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+Column_DrawCached(
+    TreeColumn column,		/* Column record. */
+    TreeDrawable td,		/* Where to draw. */
+    int x, int y		/* Top-left corner of the column's header. */
+    )
+{
+    TreeCtrl *tree = column->tree;
+    Tk_Window tkwin = tree->tkwin;
+    int width = column->useWidth;
+    int height = tree->headerHeight;
+    int state = Column_MakeState(column);
+    TreeDrawable tp;
+
+    if (width <= 0 || height <= 0)
+	return;
+
+    /* Don't keep a huge pixmap around for a column wider than the
+     * window. */
+    if (width > Tk_Width(tkwin)) {
+	if (column->hdrPixmap != None) {
+	    Tk_FreePixmap(tree->display, column->hdrPixmap);
+	    column->hdrPixmap = None;
+	}
+	Column_Draw(column, td, x, y, FALSE);
+	return;
+    }
+
+    if ((column->hdrPixmap != None) &&
+	    ((column->hdrWidth != width) || (column->hdrHeight != height))) {
+	Tk_FreePixmap(tree->display, column->hdrPixmap);
+	column->hdrPixmap = None;
+    }
+    if (column->hdrPixmap == None) {
+	column->hdrPixmap = Tk_GetPixmap(tree->display, Tk_WindowId(tkwin),
+		width, height, Tk_Depth(tkwin));
+	column->hdrWidth = width;
+	column->hdrHeight = height;
+	column->hdrValid = FALSE;
+    }
+
+    if (!column->hdrValid || (column->hdrState != state) ||
+	    (column->hdrArrow != column->arrow)) {
+	tp.drawable = column->hdrPixmap;
+	tp.width = width;
+	tp.height = height;
+	Column_Draw(column, tp, 0, 0, FALSE);
+	column->hdrState = state;
+	column->hdrArrow = column->arrow;
+	column->hdrValid = TRUE;
+    }
+
+    XCopyArea(tree->display, column->hdrPixmap, td.drawable,
+	    tree->copyGC, 0, 0, width, height, x, y);
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -4687,15 +4774,14 @@ SetImageForColumn(
     Column_Draw(column, td, 0, 0, TRUE);
 
     /* Pixmap -> XImage */
-    ximage = XGetImage(tree->display, td.drawable, 0, 0,
-	    (unsigned int)width, (unsigned int)height, AllPlanes, ZPixmap);
+    ximage = Tree_XGetImage(tree->tkwin, td.drawable, 0, 0, width, height);
     if (ximage == NULL)
 	panic("tkTreeColumn.c:SetImageForColumn() ximage is NULL");
 
     /* XImage -> Tk_Image */
     Tree_XImage2Photo(tree->interp, photoH, ximage, tree->columnDrag.alpha);
 
-    XDestroyImage(ximage);
+    Tree_XDestroyImage(tree->display, ximage);
     Tk_FreePixmap(tree->display, td.drawable);
 
     return Tk_GetImage(tree->interp, tree->tkwin, "::TreeCtrl::ImageColumn",
@@ -4766,7 +4852,7 @@ DrawHeaderLeft(
 
     while (column != NULL && column->lock == COLUMN_LOCK_LEFT) {
 	if (column->visible) {
-	    Column_Draw(column, td2, x, y, FALSE);
+	    Column_DrawCached(column, td2, x, y);
 	    x += column->useWidth;
 	}
 	column = column->next;
@@ -4800,7 +4886,7 @@ DrawHeaderRight(
 
     while (column != NULL && column->lock == COLUMN_LOCK_RIGHT) {
 	if (column->visible) {
-	    Column_Draw(column, td2, x, y, FALSE);
+	    Column_DrawCached(column, td2, x, y);
 	    x += column->useWidth;
 	}
 	column = column->next;
@@ -4867,7 +4953,7 @@ Tree_DrawHeader(
     while (column != NULL && column->lock == COLUMN_LOCK_NONE) {
 	if (column->visible) {
 	    if ((x < maxX) && (x + column->useWidth > minX))
-		Column_Draw(column, tp, x, y, FALSE);
+		Column_DrawCached(column, tp, x, y);
 	    x += column->useWidth;
 	}
 	column = column->next;
@@ -5063,6 +5149,41 @@ Tree_InvalidateColumnHeight(
     tree->headerHeight = -1;
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * Tree_InvalidateColumnHeader --
+ *
+ *	Marks the cached picture of zero or more column headers as
+ *	out-of-date.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+Tree_InvalidateColumnHeader(
+    TreeCtrl *tree,		/* Widget info. */
+    TreeColumn column		/* Column to modify. NULL means
+				 * modify every column. */
+    )
+{
+    if (column == NULL) {
+	column = tree->columns;
+	while (column != NULL) {
+	    column->hdrValid = FALSE;
+	    column = column->next;
+	}
+    } else {
+	column->hdrValid = FALSE;
+    }
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -5088,6 +5209,9 @@ TreeColumn_TreeChanged(
 {
     TreeColumn column;
 
+    /* Any widget option may change the appearance of the headers. */
+    Tree_InvalidateColumnHeader(tree, NULL);
+
     /* Column widths are invalidated elsewhere */
     if (flagT & TREE_CONF_FONT) {
 	column = tree->columns;
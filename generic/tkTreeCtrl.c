@@ -147,6 +147,10 @@ static Tk_OptionSpec optionSpecs[] = {
     {TK_OPTION_PIXELS, "-height", "height", "Height",
      "200", Tk_Offset(TreeCtrl, heightObj), Tk_Offset(TreeCtrl, height),
      0, (ClientData) NULL, TREE_CONF_RELAYOUT},
+    {TK_OPTION_BOOLEAN, "-heightfromvisiblecolumns",
+     "heightFromVisibleColumns", "HeightFromVisibleColumns",
+     "0", -1, Tk_Offset(TreeCtrl, heightFromVisibleColumns),
+     0, (ClientData) NULL, TREE_CONF_RELAYOUT},
     {TK_OPTION_COLOR, "-highlightbackground", "highlightBackground",
      "HighlightBackground", DEF_LISTBOX_HIGHLIGHT_BG, -1, 
      Tk_Offset(TreeCtrl, highlightBgColorPtr),
@@ -530,7 +534,7 @@ static int TreeWidgetCmd(
 #ifdef DEPRECATED
 	"range",
 #endif
-	"scan", "see", "selection", "state", "style",
+	"render", "scan", "see", "selection", "state", "style",
 #ifdef DEPRECATED
 	"toggle",
 #endif
@@ -560,7 +564,7 @@ static int TreeWidgetCmd(
 #ifdef DEPRECATED
 	COMMAND_RANGE,
 #endif
-	COMMAND_SCAN, COMMAND_SEE, COMMAND_SELECTION, COMMAND_STATE,
+	COMMAND_RENDER, COMMAND_SCAN, COMMAND_SEE, COMMAND_SELECTION, COMMAND_STATE,
 	COMMAND_STYLE,
 #ifdef DEPRECATED
 	COMMAND_TOGGLE,
@@ -583,6 +587,10 @@ static int TreeWidgetCmd(
     Tcl_Preserve((ClientData) tree);
     Tree_PreserveItems(tree);
 
+    /* Commands may use the text or size of elements whose -textvariable
+     * was just written. */
+    TreeElement_UpdateTextVars(tree);
+
     switch (index) {
 	case COMMAND_ACTIVATE: {
 	    TreeItem active, item;
@@ -867,22 +875,32 @@ static int TreeWidgetCmd(
 	    char buf[64];
 	    int hit;
 	    int lock;
+	    int rowOnly = FALSE;
+	    static CONST char *identifyOptions[] = { "-rowonly", NULL };
 /*
-  set id [$tree identify $x $y]
+  set id [$tree identify ?-rowonly? $x $y]
   "item I column C" : mouse is in column C of item I
   "item I column C elem E" : mouse is in element E in column C of item I
   "item I button" : mouse is in button-area of item I
   "item I line J" : mouse is near line coming from item J
   "header C ?left|right?" : mouse is in header column C
   "" : mouse is not in any item
+  With -rowonly the "elem", "button" and "line" parts are never returned.
 */
-	    if (objc != 4) {
-		Tcl_WrongNumArgs(interp, 2, objv, "x y");
+	    if (objc != 4 && objc != 5) {
+		Tcl_WrongNumArgs(interp, 2, objv, "?-rowonly? x y");
 		goto error;
 	    }
-	    if (Tk_GetPixelsFromObj(interp, tree->tkwin, objv[2], &x) != TCL_OK)
+	    if (objc == 5) {
+		int index;
+		if (Tcl_GetIndexFromObj(interp, objv[2], identifyOptions,
+			"option", 0, &index) != TCL_OK)
+		    goto error;
+		rowOnly = TRUE;
+	    }
+	    if (Tk_GetPixelsFromObj(interp, tree->tkwin, objv[objc - 2], &x) != TCL_OK)
 		goto error;
-	    if (Tk_GetPixelsFromObj(interp, tree->tkwin, objv[3], &y) != TCL_OK)
+	    if (Tk_GetPixelsFromObj(interp, tree->tkwin, objv[objc - 1], &y) != TCL_OK)
 		goto error;
 
 	    hit = Tree_HitTest(tree, x, y);
@@ -935,8 +953,11 @@ static int TreeWidgetCmd(
 		(hit == TREE_AREA_RIGHT) ? COLUMN_LOCK_RIGHT :
 		COLUMN_LOCK_NONE;
 
+	    if (rowOnly) {
+		TreeItem_Identify(tree, item, lock, x, y, TRUE, buf);
+
 	    /* Point is in a line or button */
-	    if (tree->columnTreeVis &&
+	    } else if (tree->columnTreeVis &&
 		    (TreeColumn_Lock(tree->columnTree) == lock) &&
 		    (x >= tree->columnTreeLeft) &&
 		    (x < tree->columnTreeLeft + TreeColumn_UseWidth(tree->columnTree)) &&
@@ -958,7 +979,7 @@ static int TreeWidgetCmd(
 				TreeItem_GetID(tree, item)); /* TreeItem_ToObj() */
 		}
 	    } else {
-		TreeItem_Identify(tree, item, lock, x, y, buf);
+		TreeItem_Identify(tree, item, lock, x, y, FALSE, buf);
 	    }
 	    Tcl_SetResult(interp, buf, TCL_VOLATILE);
 	    break;
@@ -1072,6 +1093,12 @@ static int TreeWidgetCmd(
 	}
 #endif /* DEPRECATED */
 
+	/* T render ?-allrows? ?-region {x1 y1 x2 y2}? photo */
+	case COMMAND_RENDER: {
+	    result = TreeDisplay_RenderCmd(tree, objc, objv);
+	    break;
+	}
+
 	case COMMAND_SCAN: {
 	    static CONST char *optionName[] = { "dragto", "mark",
 						(char *) NULL };
@@ -1585,6 +1612,9 @@ TreeWorldChanged(
     XGCValues gcValues;
     unsigned long gcMask;
 
+    /* Font metrics may have changed. */
+    Tree_FreeTextCache(tree);
+
     gcValues.font = Tk_FontId(tree->tkfont);
     gcValues.foreground = tree->fgColorPtr->pixel;
     gcValues.graphics_exposures = False;
@@ -1680,6 +1710,7 @@ TreeEventProc(
 	case VirtualEvent:
 	    if (!strcmp("ThemeChanged", ((XVirtualEvent *)(eventPtr))->name)) {
 		TreeTheme_ThemeChanged(tree);
+		Tree_InvalidateColumnHeader(tree, NULL);
 		tree->widthOfColumns = -1;
 		tree->widthOfColumnsLeft = tree->widthOfColumnsRight = -1;
 		Tree_RelayoutWindow(tree);
@@ -1781,6 +1812,8 @@ TreeDestroy(
     if (tree->lineGC != None)
 	Tk_FreeGC(tree->display, tree->lineGC);
     Tree_FreeAllGC(tree);
+    Tree_FreeTextCache(tree);
+    TreeElement_Free(tree);
 
     Tree_FreeColumns(tree);
 
@@ -2076,6 +2109,12 @@ ImageChangedProc(
     /* FIXME: this is used for the background image, but whitespace
      * is not redrawn if the background image is modified. */
 
+    /* The image may be displayed in a column header. */
+    Tree_InvalidateColumnHeader(tree, NULL);
+
+    /* The image may be the -backgroundimage. */
+    Tree_InvalidateBackgroundImage(tree);
+
     Tree_DInfoChanged(tree, DINFO_INVALIDATE | DINFO_OUT_OF_DATE);
 }
 
@@ -3354,10 +3393,11 @@ TreeDebugCmd(
 {
     TreeCtrl *tree = clientData;
     static CONST char *commandNames[] = {
-	"alloc", "cget", "configure", "dinfo", "expose", "scroll", (char *) NULL
+	"alloc", "cget", "configure", "dinfo", "expose", "scroll",
+	"textcache", (char *) NULL
     };
     enum { COMMAND_ALLOC, COMMAND_CGET, COMMAND_CONFIGURE, COMMAND_DINFO,
-	COMMAND_EXPOSE, COMMAND_SCROLL };
+	COMMAND_EXPOSE, COMMAND_SCROLL, COMMAND_TEXTCACHE };
     int index;
 
     if (objc < 3) {
@@ -3482,6 +3522,16 @@ TreeDebugCmd(
 		);
 	    break;
 	}
+
+	/* T debug textcache */
+	case COMMAND_TEXTCACHE: {
+	    if (objc != 3) {
+		Tcl_WrongNumArgs(interp, 3, objv, (char *) NULL);
+		return TCL_ERROR;
+	    }
+	    Tree_TextCacheStats(tree, interp);
+	    break;
+	}
     }
 
     return TCL_OK;
@@ -3709,6 +3759,7 @@ ImageTintCmd(
     Tk_PhotoImageBlock photoBlock;
     XColor *xColor;
     unsigned char *pixelPtr, *photoPix;
+    unsigned char red, green, blue;
     int x, y, alpha, imgW, imgH, pitch;
 
     if (objc != 4) {
@@ -3742,10 +3793,15 @@ ImageTintCmd(
     imgH = photoBlock.height;
     pitch = photoBlock.pitch;
 
-    pixelPtr = (unsigned char *) Tcl_Alloc(imgW * 4);
+    if ((imgW <= 0) || (imgH <= 0))
+	return TCL_OK;
+
+    /* Build the whole tint and composite it with a single call instead
+     * of one call per row. */
+    pixelPtr = (unsigned char *) Tcl_Alloc(imgW * imgH * 4);
     photoBlock.pixelPtr = pixelPtr;
     photoBlock.width = imgW;
-    photoBlock.height = 1;
+    photoBlock.height = imgH;
     photoBlock.pitch = imgW * 4;
     photoBlock.pixelSize = 4;
     photoBlock.offset[0] = 0;
@@ -3753,23 +3809,26 @@ ImageTintCmd(
     photoBlock.offset[2] = 2;
     photoBlock.offset[3] = 3;
 
-    for (x = 0; x < imgW; x++) {
-	pixelPtr[x*4 + 0] = UCHAR(((double) xColor->red / USHRT_MAX) * 255);
-	pixelPtr[x*4 + 1] = UCHAR(((double) xColor->green / USHRT_MAX) * 255);
-	pixelPtr[x*4 + 2] = UCHAR(((double) xColor->blue / USHRT_MAX) * 255);
-    }
+    red = Tree_Color8(xColor->red);
+    green = Tree_Color8(xColor->green);
+    blue = Tree_Color8(xColor->blue);
+
     for (y = 0; y < imgH; y++) {
 	for (x = 0; x < imgW; x++) {
+	    pixelPtr[x*4 + 0] = red;
+	    pixelPtr[x*4 + 1] = green;
+	    pixelPtr[x*4 + 2] = blue;
 	    if (photoPix[x * 4 + 3]) {
 		pixelPtr[x * 4 + 3] = alpha;
 	    } else {
 		pixelPtr[x * 4 + 3] = 0;
 	    }
 	}
-	TK_PHOTOPUTBLOCK(interp, photoH, &photoBlock, 0, y,
-		imgW, 1, TK_PHOTO_COMPOSITE_OVERLAY);
+	pixelPtr += photoBlock.pitch;
 	photoPix += pitch;
     }
+    TK_PHOTOPUTBLOCK(interp, photoH, &photoBlock, 0, 0,
+	    imgW, imgH, TK_PHOTO_COMPOSITE_OVERLAY);
     Tcl_Free((char *) photoBlock.pixelPtr);
 
     return TCL_OK;
@@ -4024,8 +4083,7 @@ LoupeCmd(
     CGDisplayShowCursor(kCGDirectMainDisplay);
     }
 #else
-    ximage = XGetImage(display, rootWindow,
-	    grabX, grabY, grabW, grabH, AllPlanes, ZPixmap);
+    ximage = Tree_XGetImage(tkwin, rootWindow, grabX, grabY, grabW, grabH);
     if (ximage == NULL) {
 	FormatResult(interp, "XGetImage() failed");
 	return TCL_ERROR;
@@ -4080,13 +4138,13 @@ LoupeCmd(
 		r = (pixel & ximage->red_mask) >> red_shift;
 		g = (pixel & ximage->green_mask) >> green_shift;
 		b = (pixel & ximage->blue_mask) >> blue_shift;
-		r = ((double) xcolors[r].red / USHRT_MAX) * 255;
-		g = ((double) xcolors[g].green / USHRT_MAX) * 255;
-		b = ((double) xcolors[b].blue / USHRT_MAX) * 255;
+		r = Tree_Color8(xcolors[r].red);
+		g = Tree_Color8(xcolors[g].green);
+		b = Tree_Color8(xcolors[b].blue);
 	    } else {
-		r = ((double) xcolors[pixel].red / USHRT_MAX) * 255;
-		g = ((double) xcolors[pixel].green / USHRT_MAX) * 255;
-		b = ((double) xcolors[pixel].blue / USHRT_MAX) * 255;
+		r = Tree_Color8(xcolors[pixel].red);
+		g = Tree_Color8(xcolors[pixel].green);
+		b = Tree_Color8(xcolors[pixel].blue);
 	    }
 	    pixelPtr[y * photoBlock.pitch + x * 4 + 0] = r;
 	    pixelPtr[y * photoBlock.pitch + x * 4 + 1] = g;
@@ -4102,12 +4160,277 @@ LoupeCmd(
     Tcl_Free((char *) pixelPtr);
 #if !defined(WIN32) && !defined(MAC_TCL) && !defined(MAC_OSX_TK)
     ckfree((char *) xcolors);
-    XDestroyImage(ximage);
+    Tree_XDestroyImage(display, ximage);
 #endif
 
     return TCL_OK;
 }
 
+#ifdef TREECTRL_BENCH
+
+/*
+ *--------------------------------------------------------------
+ *
+ * BenchCmd --
+ *
+ *	This procedure is invoked to process the [treectrl::bench]
+ *	Tcl command. The command calls one of the internal routines
+ *	that show up in profiles over and over in a tight loop,
+ *	without any Tcl dispatch overhead, and reports how long each
+ *	call took and how many TreeAlloc allocations were made.
+ *
+ * Results:
+ *	A standard Tcl result. The result is a list of key/value pairs:
+ *	routine, iterations, ns_per_op, allocs, allocs_per_op and
+ *	blocks.
+ *
+ * Side effects:
+ *	Whatever the routine does. "ranges" schedules a redraw.
+ *
+ *--------------------------------------------------------------
+ */
+
+static int
+BenchCmd(
+    ClientData clientData,	/* Not used. */
+    Tcl_Interp *interp,		/* Current interpreter. */
+    int objc,			/* Number of arguments. */
+    Tcl_Obj *CONST objv[]	/* Argument values. */
+    )
+{
+    static CONST char *routineNames[] = {
+	"dictcompare", "ellipsis", "forstate", "itemlist", "layouth",
+	"ranges", "tagexpr", "textlayout", (char *) NULL
+    };
+    enum {
+	ROUTINE_DICTCOMPARE, ROUTINE_ELLIPSIS, ROUTINE_FORSTATE,
+	ROUTINE_ITEMLIST, ROUTINE_LAYOUTH, ROUTINE_RANGES, ROUTINE_TAGEXPR,
+	ROUTINE_TEXTLAYOUT
+    };
+    static struct {
+	int numArgs;
+	char *args;
+    } argInfo[] = {
+	{ 2, "string1 string2" },	/* dictcompare */
+	{ 2, "text width" },		/* ellipsis */
+	{ 2, "perStateColor stateList" }, /* forstate */
+	{ 1, "itemDesc" },		/* itemlist */
+	{ 2, "item column" },		/* layouth */
+	{ 0, "" },			/* ranges */
+	{ 2, "tagExpr tagList" },	/* tagexpr */
+	{ 2, "text width" }		/* textlayout */
+    };
+    Tcl_CmdInfo cmdInfo;
+    TreeCtrl *tree;
+    int index, iterations, i, result = TCL_OK;
+    Tcl_Time t1, t2;
+    unsigned long allocs1, allocs2, blocks1, blocks2;
+    double usec;
+    Tcl_Obj *listObj;
+
+    if (objc < 4) {
+	Tcl_WrongNumArgs(interp, 1, objv, "path routine iterations ?arg ...?");
+	return TCL_ERROR;
+    }
+    if (!Tcl_GetCommandInfo(interp, Tcl_GetString(objv[1]), &cmdInfo) ||
+	    (cmdInfo.objProc != TreeWidgetCmd)) {
+	FormatResult(interp, "\"%s\" isn't a treectrl widget",
+		Tcl_GetString(objv[1]));
+	return TCL_ERROR;
+    }
+    tree = (TreeCtrl *) cmdInfo.objClientData;
+    if (Tcl_GetIndexFromObj(interp, objv[2], routineNames, "routine", 0,
+	    &index) != TCL_OK)
+	return TCL_ERROR;
+    if (Tcl_GetIntFromObj(interp, objv[3], &iterations) != TCL_OK)
+	return TCL_ERROR;
+    if (iterations < 1) {
+	FormatResult(interp, "bad iterations \"%d\": must be > 0",
+		iterations);
+	return TCL_ERROR;
+    }
+    if (objc - 4 != argInfo[index].numArgs) {
+	FormatResult(interp, "wrong # args: should be \"%s path %s iterations %s\"",
+		Tcl_GetString(objv[0]), routineNames[index],
+		argInfo[index].args);
+	return TCL_ERROR;
+    }
+
+    Tcl_Preserve((ClientData) tree);
+    TreeAlloc_Counts(tree->allocData, &allocs1, &blocks1);
+    Tcl_GetTime(&t1);
+
+    switch (index) {
+	case ROUTINE_DICTCOMPARE: {
+	    (void) TreeItem_BenchDictionaryCompare(Tcl_GetString(objv[4]),
+		    Tcl_GetString(objv[5]), iterations);
+	    break;
+	}
+
+	case ROUTINE_ELLIPSIS: {
+	    int length, width, maxPixels;
+	    char *text = Tcl_GetStringFromObj(objv[4], &length);
+
+	    if (Tk_GetPixelsFromObj(interp, tree->tkwin, objv[5],
+		    &width) != TCL_OK) {
+		result = TCL_ERROR;
+		break;
+	    }
+	    Tcl_GetTime(&t1);
+	    for (i = 0; i < iterations; i++) {
+		maxPixels = width;
+		(void) Tree_Ellipsis(tree, tree->tkfont, text, length, &maxPixels,
+			"...", FALSE);
+	    }
+	    break;
+	}
+
+	case ROUTINE_FORSTATE: {
+	    PerStateInfo pInfo;
+	    int states[3], match;
+
+	    if (Tree_StateFromListObj(tree, objv[5], states,
+		    SFO_NOT_OFF | SFO_NOT_TOGGLE) != TCL_OK) {
+		result = TCL_ERROR;
+		break;
+	    }
+	    memset(&pInfo, '\0', sizeof(pInfo));
+	    pInfo.obj = objv[4];
+	    Tcl_IncrRefCount(pInfo.obj);
+	    if (PerStateInfo_FromObj(tree, TreeStateFromObj, &pstColor,
+		    &pInfo) != TCL_OK) {
+		Tcl_DecrRefCount(pInfo.obj);
+		result = TCL_ERROR;
+		break;
+	    }
+	    Tcl_GetTime(&t1);
+	    for (i = 0; i < iterations; i++) {
+		/* Time the search, not a lookup in the cache. */
+		PerStateInfo_ClearCache(&pInfo);
+		(void) PerStateInfo_ForState(tree, &pstColor, &pInfo,
+			states[STATE_OP_ON], &match);
+	    }
+	    Tcl_GetTime(&t2);
+	    PerStateInfo_Free(tree, &pstColor, &pInfo);
+	    Tcl_DecrRefCount(pInfo.obj);
+	    goto done;
+	}
+
+	case ROUTINE_ITEMLIST: {
+	    TreeItemList items;
+
+	    for (i = 0; i < iterations; i++) {
+		if (TreeItemList_FromObj(tree, objv[4], &items, 0) != TCL_OK) {
+		    result = TCL_ERROR;
+		    break;
+		}
+		TreeItemList_Free(&items);
+	    }
+	    break;
+	}
+
+	case ROUTINE_LAYOUTH: {
+	    TreeItem item;
+	    TreeColumn treeColumn;
+
+	    if ((TreeItem_FromObj(tree, objv[4], &item, IFO_NOT_NULL)
+		    != TCL_OK) ||
+		    (TreeColumn_FromObj(tree, objv[5], &treeColumn,
+		    CFO_NOT_NULL | CFO_NOT_TAIL) != TCL_OK)) {
+		result = TCL_ERROR;
+		break;
+	    }
+	    /* Get the column widths and item heights up to date first. */
+	    (void) Tree_WidthOfColumns(tree);
+	    (void) TreeItem_Height(tree, item);
+	    Tcl_GetTime(&t1);
+	    result = TreeItem_BenchLayout(tree, item, treeColumn, iterations);
+	    break;
+	}
+
+	case ROUTINE_RANGES: {
+	    TreeDisplay_BenchRanges(tree, iterations);
+	    break;
+	}
+
+	case ROUTINE_TAGEXPR: {
+	    TagExpr expr;
+	    TagInfo *tagInfo;
+
+	    if (TagInfo_FromObj(tree, objv[5], &tagInfo) != TCL_OK) {
+		result = TCL_ERROR;
+		break;
+	    }
+	    if (TagExpr_Init(tree, objv[4], &expr) != TCL_OK) {
+		TagInfo_Free(tree, tagInfo);
+		result = TCL_ERROR;
+		break;
+	    }
+	    Tcl_GetTime(&t1);
+	    for (i = 0; i < iterations; i++)
+		(void) TagExpr_Eval(&expr, tagInfo);
+	    Tcl_GetTime(&t2);
+	    TagExpr_Free(&expr);
+	    TagInfo_Free(tree, tagInfo);
+	    goto done;
+	}
+
+	case ROUTINE_TEXTLAYOUT: {
+	    int length, width;
+	    char *text = Tcl_GetStringFromObj(objv[4], &length);
+	    TextLayout layout;
+
+	    if (Tk_GetPixelsFromObj(interp, tree->tkwin, objv[5],
+		    &width) != TCL_OK) {
+		result = TCL_ERROR;
+		break;
+	    }
+	    length = Tcl_NumUtfChars(text, length);
+	    Tcl_GetTime(&t1);
+	    for (i = 0; i < iterations; i++) {
+		layout = TextLayout_Compute(tree, tree->tkfont, text, length,
+			width, TK_JUSTIFY_LEFT, 0, 0);
+		TextLayout_Free(layout);
+	    }
+	    break;
+	}
+    }
+    Tcl_GetTime(&t2);
+
+done:
+    TreeAlloc_Counts(tree->allocData, &allocs2, &blocks2);
+    Tcl_Release((ClientData) tree);
+    if (result != TCL_OK)
+	return TCL_ERROR;
+
+    usec = (t2.sec - t1.sec) * 1000000.0 + (t2.usec - t1.usec);
+    listObj = Tcl_NewListObj(0, NULL);
+    Tcl_ListObjAppendElement(interp, listObj, Tcl_NewStringObj("routine", -1));
+    Tcl_ListObjAppendElement(interp, listObj,
+	    Tcl_NewStringObj(routineNames[index], -1));
+    Tcl_ListObjAppendElement(interp, listObj,
+	    Tcl_NewStringObj("iterations", -1));
+    Tcl_ListObjAppendElement(interp, listObj, Tcl_NewIntObj(iterations));
+    Tcl_ListObjAppendElement(interp, listObj,
+	    Tcl_NewStringObj("ns_per_op", -1));
+    Tcl_ListObjAppendElement(interp, listObj,
+	    Tcl_NewDoubleObj(usec * 1000.0 / iterations));
+    Tcl_ListObjAppendElement(interp, listObj, Tcl_NewStringObj("allocs", -1));
+    Tcl_ListObjAppendElement(interp, listObj,
+	    Tcl_NewLongObj((long) (allocs2 - allocs1)));
+    Tcl_ListObjAppendElement(interp, listObj,
+	    Tcl_NewStringObj("allocs_per_op", -1));
+    Tcl_ListObjAppendElement(interp, listObj,
+	    Tcl_NewDoubleObj((double) (allocs2 - allocs1) / iterations));
+    Tcl_ListObjAppendElement(interp, listObj, Tcl_NewStringObj("blocks", -1));
+    Tcl_ListObjAppendElement(interp, listObj,
+	    Tcl_NewLongObj((long) (blocks2 - blocks1)));
+    Tcl_SetObjResult(interp, listObj);
+    return TCL_OK;
+}
+
+#endif /* TREECTRL_BENCH */
+
 #ifndef USE_TTK
 
 /*
@@ -4260,6 +4583,11 @@ Treectrl_Init(
     /* Screen magnifier to check those dotted lines. */
     Tcl_CreateObjCommand(interp, "loupe", LoupeCmd, NULL, NULL);
 
+#ifdef TREECTRL_BENCH
+    /* Time internal routines without the Tcl overhead. */
+    Tcl_CreateObjCommand(interp, "::treectrl::bench", BenchCmd, NULL, NULL);
+#endif
+
     Tcl_CreateObjCommand(interp, "treectrl", TreeObjCmd, NULL, NULL);
 
     if (Tcl_PkgProvide(interp, PACKAGE_NAME, PACKAGE_PATCHLEVEL) != TCL_OK) {
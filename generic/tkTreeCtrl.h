@@ -78,8 +78,16 @@ struct PerStateInfo
     Tcl_Obj *obj;
     int count;
     PerStateData *data;
+#define PERSTATE_CACHE_SIZE 4	/* Must be a power of 2. */
+    int cacheState[PERSTATE_CACHE_SIZE]; /* States recently looked up by
+				 * PerStateInfo_ForState(). */
+    int cacheResult[PERSTATE_CACHE_SIZE]; /* Result for each state, or
+				 * zero if unused. */
 };
 
+#define PerStateInfo_ClearCache(pInfo) \
+    memset((pInfo)->cacheResult, '\0', sizeof((pInfo)->cacheResult))
+
 typedef int (*PerStateType_FromObjProc)(TreeCtrl *, Tcl_Obj *, PerStateData *);
 typedef void (*PerStateType_FreeProc)(TreeCtrl *, PerStateData *);
 
@@ -106,6 +114,9 @@ typedef struct
     int width, height;
 } TreeRectangle;
 
+typedef struct TreeTextCache TreeTextCache;
+typedef struct TreeTextVars TreeTextVars;
+
 typedef struct GCCache GCCache;
 struct GCCache
 {
@@ -219,6 +230,7 @@ struct TreeCtrl
     int itemHeight;		/* -itemheight */
     Tcl_Obj *minItemHeightObj;	/* -minitemheight: Minimum height for all items */
     int minItemHeight;		/* -minitemheight */
+    int heightFromVisibleColumns; /* -heightfromvisiblecolumns: boolean */
     Tcl_Obj *itemWidthObj;	/* -itemwidth */
     int itemWidth;		/* -itemwidth */
     int itemWidthEqual;		/* -itemwidthequal */
@@ -295,6 +307,9 @@ struct TreeCtrl
     int prevHeight;
     int drawableXOrigin;
     int drawableYOrigin;
+    int drawableOffscreen;	/* TRUE while [render] draws. The drawable
+				 * may show a different scroll position than
+				 * the window. */
 
     TreeColumn columns;		/* List of columns */
     TreeColumn columnLast;	/* Last in list of columns */
@@ -400,6 +415,10 @@ struct TreeCtrl
 
     TreeThemeData themeData;
     GCCache *gcCache;		/* Graphics contexts for elements. */
+    TreeTextCache *textCache;	/* Widths of recently-measured text. */
+    Tcl_HashTable *textFormatHash; /* Compiled text element -format
+				 * strings. */
+    TreeTextVars *textVars;	/* Text element -textvariable traces. */
 
     TkRegion regionStack[8];	/* Temp region stack. */
     int regionStackLen;		/* Number of unused regions in regionStack. */
@@ -556,6 +575,12 @@ extern TreeItemRInfo TreeItem_GetRInfo(TreeCtrl *tree, TreeItem item);
 extern void TreeItem_AppendChild(TreeCtrl *tree, TreeItem self, TreeItem child);
 extern void TreeItem_RemoveFromParent(TreeCtrl *tree, TreeItem self);
 extern int TreeItem_FirstAndLast(TreeCtrl *tree, TreeItem *first, TreeItem *last);
+#ifdef TREECTRL_BENCH
+extern int TreeItem_BenchDictionaryCompare(char *left, char *right,
+	int iterations);
+extern int TreeItem_BenchLayout(TreeCtrl *tree, TreeItem item,
+	TreeColumn treeColumn, int iterations);
+#endif
 extern void TreeItem_ListDescendants(TreeCtrl *tree, TreeItem item_, TreeItemList *items);
 extern int TreeItem_Height(TreeCtrl *tree, TreeItem self);
 extern int TreeItem_TotalHeight(TreeCtrl *tree, TreeItem self);
@@ -576,7 +601,7 @@ extern TreeItem TreeItem_Next(TreeCtrl *tree, TreeItem item);
 extern TreeItem TreeItem_NextVisible(TreeCtrl *tree, TreeItem item);
 extern TreeItem TreeItem_Prev(TreeCtrl *tree, TreeItem item);
 extern TreeItem TreeItem_PrevVisible(TreeCtrl *tree, TreeItem item);
-extern void TreeItem_Identify(TreeCtrl *tree, TreeItem item_, int lock, int x, int y, char *buf);
+extern void TreeItem_Identify(TreeCtrl *tree, TreeItem item_, int lock, int x, int y, int rowOnly, char *buf);
 extern void TreeItem_Identify2(TreeCtrl *tree, TreeItem item_,
 	int x1, int y1, int x2, int y2, Tcl_Obj *listObj);
 extern int TreeItem_GetRects(TreeCtrl *tree, TreeItem item_,
@@ -604,6 +629,8 @@ extern void TreeItem_MoveColumn(TreeCtrl *tree, TreeItem item_, int columnIndex,
 
 /* tkTreeElem.c */
 extern int TreeElement_Init(Tcl_Interp *interp);
+extern void TreeElement_Free(TreeCtrl *tree);
+extern void TreeElement_UpdateTextVars(TreeCtrl *tree);
 extern int TreeStateFromObj(TreeCtrl *tree, Tcl_Obj *obj, int *stateOff, int *stateOn);
 extern int StringTableCO_Init(Tk_OptionSpec *optionTable, CONST char *optionName, CONST char **tablePtr);
 
@@ -623,6 +650,30 @@ struct StyleDrawArgs
     int bounds[4];
 };
 
+/* The visible element rectangles of a style as laid out by the last
+ * [identify] in an onscreen item. One of these lives in each DItem so
+ * repeated hit-testing under a motionless item skips Style_DoLayout. */
+typedef struct StyleHitRect
+{
+    CONST char *name;		/* Element name (a Tk_Uid). */
+    int x, y, width, height;	/* Relative to the style. */
+} StyleHitRect;
+
+typedef struct StyleHitCache StyleHitCache;
+struct StyleHitCache
+{
+    TreeStyle style;		/* Instance style laid out, or NULL if the
+				 * cache is empty. */
+    int state;			/* The remaining fields are the layout */
+    int indent;			/* arguments the rectangles were computed */
+    int width;			/* with. */
+    int height;
+    Tk_Justify justify;
+    int count;			/* Number of rects[] used. */
+    int alloc;			/* Size of rects[]. */
+    StyleHitRect *rects;	/* Bottom-most element first. */
+};
+
 /* tkTreeStyle.c */
 extern int TreeStyle_Init(TreeCtrl *tree);
 extern int TreeStyle_NeededWidth(TreeCtrl *tree, TreeStyle style_, int state);
@@ -640,13 +691,15 @@ extern Tcl_Obj *TreeStyle_GetText(TreeCtrl *tree, TreeStyle style_);
 extern int TreeStyle_SetImage(TreeCtrl *tree, TreeItem item, TreeItemColumn column, TreeStyle style_, Tcl_Obj *textObj);
 extern int TreeStyle_SetText(TreeCtrl *tree, TreeItem item, TreeItemColumn column, TreeStyle style_, Tcl_Obj *textObj);
 extern int TreeStyle_FindElement(TreeCtrl *tree, TreeStyle style_, TreeElement elem, int *index);
-extern TreeStyle TreeStyle_NewInstance(TreeCtrl *tree, TreeStyle master);
+extern TreeStyle TreeStyle_NewInstance(TreeCtrl *tree, TreeStyle master,
+    TreeItem item, TreeItemColumn column);
 extern int TreeStyle_ElementActual(TreeCtrl *tree, TreeStyle style_, int state, Tcl_Obj *elemObj, Tcl_Obj *obj);
 extern int TreeStyle_ElementCget(TreeCtrl *tree, TreeItem item, TreeItemColumn column, TreeStyle style_, Tcl_Obj *elemObj, Tcl_Obj *obj);
 extern int TreeStyle_ElementConfigure(TreeCtrl *tree, TreeItem item, TreeItemColumn column, TreeStyle style_, Tcl_Obj *elemObj, int objc, Tcl_Obj **objv, int *eMask);
 extern void TreeStyle_ListElements(TreeCtrl *tree, TreeStyle style_);
 extern TreeStyle TreeStyle_GetMaster(TreeCtrl *tree, TreeStyle style_);
-extern char *TreeStyle_Identify(StyleDrawArgs *drawArgs, int x, int y);
+extern char *TreeStyle_Identify(StyleDrawArgs *drawArgs, int x, int y,
+    StyleHitCache *hits);
 extern void TreeStyle_Identify2(StyleDrawArgs *drawArgs,
 	int x1, int y1, int x2, int y2, Tcl_Obj *listObj);
 extern int TreeStyle_Remap(TreeCtrl *tree, TreeStyle styleFrom_, TreeStyle styleTo_, int objc, Tcl_Obj *CONST objv[]);
@@ -661,6 +714,9 @@ extern int TreeStyle_GetSortData(TreeCtrl *tree, TreeStyle style_, int elemIndex
 extern int TreeStyle_ValidateElements(TreeCtrl *tree, TreeStyle style_, int objc, Tcl_Obj *CONST objv[]);
 #endif
 extern int TreeStyle_GetElemRects(StyleDrawArgs *drawArgs, int objc, Tcl_Obj *CONST objv[], TreeRectangle rects[]);
+#ifdef TREECTRL_BENCH
+extern void TreeStyle_BenchLayoutH(StyleDrawArgs *drawArgs, int iterations);
+#endif
 extern int TreeElementCmd(ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *CONST objv[]);
 extern int TreeStyleCmd(ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *CONST objv[]);
 extern int TreeStyle_ChangeState(TreeCtrl *tree, TreeStyle style_, int state1, int state2);
@@ -681,6 +737,7 @@ extern void TreeNotify_ActiveItem(TreeCtrl *tree, TreeItem itemOld, TreeItem ite
 extern void TreeNotify_Scroll(TreeCtrl *tree, double fractions[2], int vertical);
 extern void TreeNotify_ItemDeleted(TreeCtrl *tree, TreeItemList *items);
 extern void TreeNotify_ItemVisibility(TreeCtrl *tree, TreeItemList *v, TreeItemList *h);
+extern int TreeNotify_WantItemVisibility(TreeCtrl *tree);
 
 /* tkTreeColumn.c */
 extern int TreeColumn_InitInterp(Tcl_Interp *interp);
@@ -746,6 +803,7 @@ extern void TreeColumn_Init(TreeCtrl *tree);
 extern void Tree_FreeColumns(TreeCtrl *tree);
 extern void Tree_InvalidateColumnWidth(TreeCtrl *tree, TreeColumn column);
 extern void Tree_InvalidateColumnHeight(TreeCtrl *tree, TreeColumn column);
+extern void Tree_InvalidateColumnHeader(TreeCtrl *tree, TreeColumn column);
 extern int Tree_HeaderHeight(TreeCtrl *tree);
 extern int TreeColumn_Bbox(TreeColumn column, int *x, int *y, int *w, int *h);
 extern TreeColumn Tree_HeaderUnderPoint(TreeCtrl *tree, int *x_, int *y_, int *w, int *h, int nearest);
@@ -816,11 +874,17 @@ extern void Tree_SetOriginY(TreeCtrl *tree, int yOrigin);
 extern void Tree_RelayoutWindow(TreeCtrl *tree);
 extern void Tree_FreeItemDInfo(TreeCtrl *tree, TreeItem item1, TreeItem item2);
 extern void Tree_InvalidateItemDInfo(TreeCtrl *tree, TreeColumn column, TreeItem item1, TreeItem item2);
+extern void Tree_InvalidateItemDInfoRect(TreeCtrl *tree, TreeColumn column, TreeItem item, int x, int y, int width, int height);
 extern void TreeDisplay_ItemDeleted(TreeCtrl *tree, TreeItem item);
 extern void TreeDisplay_ColumnDeleted(TreeCtrl *tree, TreeColumn column);
 extern void TreeDisplay_FreeColumnDInfo(TreeCtrl *tree, TreeColumn column);
 extern void TreeDisplay_GetReadyForTrouble(TreeCtrl *tree, int *requestsPtr);
 extern int TreeDisplay_WasThereTrouble(TreeCtrl *tree, int requests);
+extern int TreeDisplay_RenderCmd(TreeCtrl *tree, int objc, Tcl_Obj *CONST objv[]);
+extern StyleHitCache *TreeDisplay_ItemHitCache(TreeCtrl *tree, TreeItem item);
+#ifdef TREECTRL_BENCH
+extern void TreeDisplay_BenchRanges(TreeCtrl *tree, int iterations);
+#endif
 extern void Tree_InvalidateArea(TreeCtrl *tree, int x1, int y1, int x2, int y2);
 extern void Tree_InvalidateItemArea(TreeCtrl *tree, int x1, int y1, int x2, int y2);
 extern void Tree_InvalidateRegion(TreeCtrl *tree, TkRegion region);
@@ -835,6 +899,9 @@ extern void TreeRowProxy_Undisplay(TreeCtrl *tree);
 extern void TreeRowProxy_Display(TreeCtrl *tree);
 extern void Tree_DrawTiledImage(TreeCtrl *tree, Drawable drawable, Tk_Image image, 
     int x1, int y1, int x2, int y2, int xOffset, int yOffset);
+extern void Tree_DrawBackgroundImage(TreeCtrl *tree, Drawable drawable,
+    int x1, int y1, int x2, int y2, int xOffset, int yOffset);
+extern void Tree_InvalidateBackgroundImage(TreeCtrl *tree);
 
 #define DINFO_OUT_OF_DATE 0x0001
 #define DINFO_CHECK_COLUMN_WIDTH 0x0002
@@ -883,7 +950,7 @@ extern void TreeTheme_Relayout(TreeCtrl *tree);
 #define WFREE(p,t) WIPEFREE(p, sizeof(t))
 #define WCFREE(p,t,c) WIPEFREE(p, sizeof(t) * (c))
 
-extern int Tree_Ellipsis(Tk_Font tkfont, char *string, int numBytes, int *maxPixels, char *ellipsis, int force);
+extern int Tree_Ellipsis(TreeCtrl *tree, Tk_Font tkfont, char *string, int numBytes, int *maxPixels, char *ellipsis, int force);
 extern void Tree_HDotLine(TreeCtrl *tree, Drawable drawable, GC gc, int x1, int y1, int x2);
 extern void Tree_VDotLine(TreeCtrl *tree, Drawable drawable, GC gc, int x1, int y1, int y2);
 extern void Tree_DrawActiveOutline(TreeCtrl *tree, Drawable drawable, int x, int y, int width, int height, int open);
@@ -895,9 +962,17 @@ extern void TreeDotRect_Setup(TreeCtrl *tree, Drawable drawable, DotState *dotSt
 extern void TreeDotRect_Draw(DotState *dotState, int x, int y, int width, int height);
 extern void TreeDotRect_Restore(DotState *dotState);
 typedef struct TextLayout_ *TextLayout;
-extern TextLayout TextLayout_Compute(Tk_Font tkfont, CONST char *string,
-	int numChars, int wrapLength, Tk_Justify justify, int maxLines, int flags);
+extern TextLayout TextLayout_Compute(TreeCtrl *tree, Tk_Font tkfont,
+	CONST char *string, int numChars, int wrapLength, Tk_Justify justify,
+	int maxLines, int flags);
+extern TextLayout TextLayout_Reflow(TreeCtrl *tree, TextLayout textLayout,
+	Tk_Font tkfont, CONST char *string, int numChars, int wrapLength,
+	Tk_Justify justify, int maxLines, int flags);
 extern void TextLayout_Free(TextLayout textLayout);
+extern int Tree_TextWidth(TreeCtrl *tree, Tk_Font tkfont, CONST char *text,
+	int numBytes);
+extern void Tree_FreeTextCache(TreeCtrl *tree);
+extern void Tree_TextCacheStats(TreeCtrl *tree, Tcl_Interp *interp);
 extern void TextLayout_Size(TextLayout textLayout, int *widthPtr, int *heightPtr);
 extern int TextLayout_TotalWidth(TextLayout textLayout);
 extern void TextLayout_Draw(Display *display, Drawable drawable, GC gc,
@@ -921,7 +996,15 @@ extern void Tree_OffsetRegion(TkRegion region, int xOffset, int yOffset);
 extern int Tree_ScrollWindow(TreeCtrl *tree, GC gc, int x, int y,
 	int width, int height, int dx, int dy, TkRegion damageRgn);
 extern void Tree_UnsetClipMask(TreeCtrl *tree, Drawable drawable, GC gc);
+/* Scale a 16-bit XColor component to 8 bits, rounding to nearest. */
+#define Tree_Color8(c) \
+    ((unsigned char) (((unsigned long) (c) * 255 + 32767) / 65535))
 extern void Tree_XImage2Photo(Tcl_Interp *interp, Tk_PhotoHandle photoH, XImage *ximage, int alpha);
+extern void Tree_XImage2PhotoAt(Tcl_Interp *interp, Tk_PhotoHandle photoH,
+	XImage *ximage, int destX, int destY, int alpha);
+extern XImage *Tree_XGetImage(Tk_Window tkwin, Drawable drawable, int x, int y,
+	int width, int height);
+extern void Tree_XDestroyImage(Display *display, XImage *ximage);
 
 #define PAD_TOP_LEFT     0
 #define PAD_BOTTOM_RIGHT 1
@@ -1004,6 +1087,10 @@ extern char *TreeAlloc_Realloc(ClientData data, Tk_Uid id, char *ptr, int size1,
 extern void TreeAlloc_Free(ClientData data, Tk_Uid id, char *ptr, int size);
 extern void TreeAlloc_CFree(ClientData data, Tk_Uid id, char *ptr, int size, int count, int roundUp);
 extern void TreeAlloc_Stats(Tcl_Interp *interp, ClientData data);
+#ifdef TREECTRL_BENCH
+extern void TreeAlloc_Counts(ClientData data, unsigned long *allocPtr,
+	unsigned long *blockPtr);
+#endif
 #endif
 
 /*****/
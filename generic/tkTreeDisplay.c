@@ -21,6 +21,7 @@ typedef struct TreeDInfo_ TreeDInfo_;
 typedef struct RItem RItem;
 typedef struct Range Range;
 typedef struct DItem DItem;
+typedef struct DItemSlab DItemSlab;
 
 static void Range_RedoIfNeeded(TreeCtrl *tree);
 static int Range_TotalWidth(TreeCtrl *tree, Range *range_);
@@ -29,6 +30,7 @@ static void Range_Redo(TreeCtrl *tree);
 static Range *Range_UnderPoint(TreeCtrl *tree, int *x_, int *y_, int nearest);
 static RItem *Range_ItemUnderPoint(TreeCtrl *tree, Range *range, int *x_,
     int *y_);
+static int GetItemBgIndex(TreeCtrl *tree, RItem *rItem, int swap);
 
 /* One of these per TreeItem that is ReallyVisible(). */
 struct RItem
@@ -60,7 +62,14 @@ typedef struct DItemArea {
     int dirty[4];		/* Dirty area in item coords. */
 #define DITEM_DIRTY 0x0001
 #define DITEM_ALL_DIRTY 0x0002
+#define DITEM_CACHED 0x0004	/* Locked columns only: dInfo->pixmapL or
+				 * dInfo->pixmapR holds the pixels for this
+				 * area at cacheY. */
+#define DITEM_CACHE_DIRTY 0x0008 /* Locked columns only: the dirty part of
+				 * the cached pixels is out-of-date. */
     int flags;
+    int cacheY;			/* Window y of the cached pixels. */
+    int cacheHeight;		/* Height of the cached pixels. */
 } DItemArea;
 
 /* Display information for a TreeItem that is onscreen. */
@@ -80,9 +89,50 @@ struct DItem
     int oldIndex;		/* Used for alternating background colors. */
     int *spans;			/* span[n] is the column index of the item
 				 * column displayed at the n'th tree column. */
+    int hitStamp;		/* DInfo.hitStamp when hits was filled. */
+    StyleHitCache hits;		/* Element layout of the last [identify]. */
+    DItemSlab *slab;		/* Block of memory this DItem is part of. */
     DItem *next;
 };
 
+/* A block of DItems allocated at once. Each new slab is as big as all the
+ * previous ones put together, so a pool sized for a full window of rows
+ * takes only a few allocations. Slabs whose DItems are all unused are
+ * released when the number of onscreen items drops. Each slab keeps its
+ * own list of unused DItems, so releasing a slab doesn't have to search
+ * for its DItems. */
+struct DItemSlab
+{
+    DItemSlab *next;		/* Next slab in DInfo.dItemSlabs. */
+    int count;			/* Number of dItems[]. */
+    int used;			/* Number of dItems[] in use. */
+    DItem *free;		/* List of unused dItems[]. */
+    DItem dItems[1];		/* Actually count DItems. */
+};
+
+/* The smallest number of DItems in a slab. */
+#define DITEM_SLAB_MIN 16
+
+/* A run of vertical scroll increments. When every row has the same height
+ * the increments are evenly spaced and a whole run of them is described by
+ * its first offset and the spacing. Rows with irregular heights get their
+ * offsets listed in DInfo.yScrollIncrements[]. */
+typedef struct IncrementRun {
+    int index;			/* Index of the first increment in the run. */
+    int count;			/* Number of increments in the run. */
+    int offset;			/* Offset of the first increment. */
+    int step;			/* Distance between increments, or zero if
+				 * the offsets are listed in
+				 * DInfo.yScrollIncrements[]. */
+    int first;			/* If step is zero, index in
+				 * DInfo.yScrollIncrements[] of the first
+				 * offset. */
+} IncrementRun;
+
+/* Minimum number of evenly-spaced offsets that get turned into an
+ * IncrementRun of their own. */
+#define INCREMENT_RUN_MIN 4
+
 /* Display information for a TreeColumn. */
 struct TreeColumnDInfo_
 {
@@ -101,32 +151,65 @@ struct TreeDInfo_
     int headerHeight;		/* Last seen TreeCtrl.headerHeight */
     DItem *dItem;		/* Head of list for each displayed item */
     DItem *dItemLast;		/* Temp for UpdateDInfo() */
-    DItem *dItemFree;		/* List of unused DItems */
+    DItemSlab *dItemSlabs;	/* Every block of DItems, newest first */
+    int dItemCount;		/* Number of DItems in every slab */
+    int dItemUsed;		/* Number of DItems in use */
     Range *rangeFirst;		/* Head of Ranges */
     Range *rangeLast;		/* Tail of Ranges */
     Range *rangeFirstD;		/* First range with valid display info */
     Range *rangeLastD; 		/* Last range with valid display info */
+    Range **rangeArray;		/* Every Range, indexed by Range.index */
+    int rangeArrayMax;		/* size of rangeArray[] */
     RItem *rItem;		/* Block of RItems for all Ranges */
     int rItemMax;		/* size of rItem[] */
     int itemHeight;		/* Observed max TreeItem height */
     int itemWidth;		/* Observed max TreeItem width */
     TreeDrawable pixmapW;	/* Pixmap as big as the window */
     TreeDrawable pixmapI;	/* Pixmap as big as the largest item */
+    TreeDrawable pixmapL;	/* Cached pixels of the left-locked columns */
+    TreeDrawable pixmapR;	/* Cached pixels of the right-locked columns */
+    TreeDrawable pixmapBg;	/* -backgroundimage tiled over -background */
     TkRegion dirtyRgn;		/* DOUBLEBUFFER_WINDOW */
     int flags;			/* DINFO_XXX */
     int xScrollIncrement;	/* Last seen TreeCtr.xScrollIncrement */
     int yScrollIncrement;	/* Last seen TreeCtr.yScrollIncrement */
     int *xScrollIncrements;	/* When tree->xScrollIncrement is zero */
-    int *yScrollIncrements;	/* When tree->yScrollIncrement is zero */
+    int *yScrollIncrements;	/* Offsets for irregular IncrementRuns. */
+    int yScrollIncrementUsed;	/* Number of yScrollIncrements[] used. */
+    int yScrollIncrementMax;	/* Size of yScrollIncrements[]. */
+    IncrementRun *yIncrementRuns; /* When tree->yScrollIncrement is zero */
+    int yIncrementRunCount;	/* Number of yIncrementRuns[] used. */
+    int yIncrementRunMax;	/* Size of yIncrementRuns[]. */
     int xScrollIncrementCount;	/* Size of xScrollIncrements. */
-    int yScrollIncrementCount;	/* Size of yScrollIncrements. */
+    int yScrollIncrementCount;	/* Total number of y increments. */
     int incrementTop;		/* yScrollIncrement[] index of item at top */
     int incrementLeft;		/* xScrollIncrement[] index of item at left */
     TkRegion wsRgn;		/* Region containing whitespace */
+    TkRegion wsRgnCalc;		/* Whitespace region as of the last call to
+				 * CalcWhiteSpaceRegion(). */
+    int wsRgnCurrent;		/* TRUE if wsRgn is the same as wsRgnCalc,
+				 * and wsRgnCalc has not changed since the
+				 * whitespace was drawn. */
+    XRectangle *wsRects;	/* Rectangles making up wsRgnCalc. */
+    XRectangle *wsRectsNew;	/* Scratch space for CalcWhiteSpaceRegion(). */
+    int wsRectCount;		/* Number of wsRects[] used. */
+    int wsRectCountNew;		/* Number of wsRectsNew[] used. */
+    int wsRectMax;		/* Size of wsRects[] and wsRectsNew[]. */
 #ifdef COMPLEX_WHITESPACE
     int complexWhitespace;
 #endif
     Tcl_HashTable itemVisHash;	/* Table of visible items */
+    TreePtrList dItemNew;	/* DItems allocated since itemVisHash was
+				 * last updated. */
+    TreeItemList itemGone;	/* Items whose DItem was freed since
+				 * itemVisHash was last updated. */
+    TreeColumn *columnArray;	/* Every column, indexed by column index,
+				 * as of the last column-width check. */
+    int columnArrayCount;	/* Number of columnArray[] used. */
+    int columnArrayMax;		/* Size of columnArray[]. */
+    unsigned long *columnBits;	/* Scratch bitsets for
+				 * TrackOnScreenColumnsForItem. */
+    int columnBitsMax;		/* Number of columnBits[] words. */
     int requests;		/* Incremented for every call to
 				   Tree_EventuallyRedraw */
     int bounds[4], empty;	/* Bounds of TREE_AREA_CONTENT */
@@ -138,6 +221,8 @@ struct TreeDInfo_
 				 * columns, this range holds the vertical
 				 * offset and height of each ReallyVisible
 				 * item for displaying locked columns. */
+    int hitStamp;		/* Incremented to empty the StyleHitCache
+				 * of every DItem at once. */
 };
 
 #ifdef COMPLEX_WHITESPACE
@@ -376,6 +461,16 @@ freeRanges:
     while (rangeList != NULL)
 	rangeList = Range_Free(tree, rangeList);
 
+    /* Keep an array of Ranges so they can be found by binary search
+     * instead of walking the list. */
+    if (dInfo->rangeArrayMax < rangeIndex) {
+	dInfo->rangeArray = (Range **) ckrealloc((char *) dInfo->rangeArray,
+		rangeIndex * sizeof(Range *));
+	dInfo->rangeArrayMax = rangeIndex;
+    }
+    for (range = dInfo->rangeFirst; range != NULL; range = range->next)
+	dInfo->rangeArray[range->index] = range;
+
     /* If there are no visible non-locked columns, we won't have a Range.
      * But we need to know the offset/size of each item for drawing any
      * locked columns (and for vertical scrolling... and hit testing). */
@@ -765,6 +860,57 @@ Tree_TotalHeight(
     return tree->totalHeight;
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * Range_ByOffset --
+ *
+ *	Return the first Range whose right edge (if -orient vertical) or
+ *	bottom edge (if -orient horizontal) is at or beyond the given
+ *	canvas coordinate. The offsets of the Ranges increase with their
+ *	index, so dInfo->rangeArray is searched with a binary search.
+ *	The offset of each Range must be up-to-date, i.e.
+ *	Tree_TotalWidth() or Tree_TotalHeight() must have been called.
+ *
+ * Results:
+ *	Range, or NULL if every Range ends before the given coordinate.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static Range *
+Range_ByOffset(
+    TreeCtrl *tree,		/* Widget info. */
+    int offset			/* Canvas x (vertical) or y (horizontal)
+				 * coordinate. */
+    )
+{
+    TreeDInfo dInfo = tree->dInfo;
+    Range *range, *found = NULL;
+    int i, l, u, size;
+
+    if (dInfo->rangeLast == NULL)
+	return NULL;
+
+    /* Binary search */
+    l = 0;
+    u = dInfo->rangeLast->index;
+    while (l <= u) {
+	i = (l + u) / 2;
+	range = dInfo->rangeArray[i];
+	size = tree->vertical ? range->totalWidth : range->totalHeight;
+	if (range->offset + size >= offset) {
+	    found = range;
+	    u = i - 1;
+	} else
+	    l = i + 1;
+    }
+    return found;
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -795,7 +941,6 @@ Range_UnderPoint(
 				 * should be returned. */
     )
 {
-    TreeDInfo dInfo = tree->dInfo;
     Range *range;
     int x = *x_, y = *y_;
 
@@ -804,8 +949,6 @@ Range_UnderPoint(
     if ((Tree_TotalWidth(tree) <= 0) || (Tree_TotalHeight(tree) <= 0))
 	return NULL;
 
-    range = dInfo->rangeFirst;
-
     if (nearest) {
 	int minX, minY, maxX, maxY;
 
@@ -849,30 +992,24 @@ Range_UnderPoint(
     }
 
     if (tree->vertical) {
-	while (range != NULL) {
-	    if ((x >= range->offset) && (x < range->offset + range->totalWidth)) {
-		if (nearest || (y < range->totalHeight)) {
-		    (*x_) = x - range->offset;
-		    (*y_) = MIN(y, range->totalHeight - 1);
-		    return range;
-		}
-		return NULL;
+	range = Range_ByOffset(tree, x + 1);
+	if ((range != NULL) && (x >= range->offset)) {
+	    if (nearest || (y < range->totalHeight)) {
+		(*x_) = x - range->offset;
+		(*y_) = MIN(y, range->totalHeight - 1);
+		return range;
 	    }
-	    range = range->next;
 	}
 	return NULL;
     }
     else {
-	while (range != NULL) {
-	    if ((y >= range->offset) && (y < range->offset + range->totalHeight)) {
-		if (nearest || (x < range->totalWidth)) {
-		    (*x_) = MIN(x, range->totalWidth - 1);
-		    (*y_) = y - range->offset;
-		    return range;
-		}
-		return NULL;
+	range = Range_ByOffset(tree, y + 1);
+	if ((range != NULL) && (y >= range->offset)) {
+	    if (nearest || (x < range->totalWidth)) {
+		(*x_) = MIN(x, range->totalWidth - 1);
+		(*y_) = y - range->offset;
+		return range;
 	    }
-	    range = range->next;
 	}
 	return NULL;
     }
@@ -1013,6 +1150,196 @@ Increment_AddX(
     return size;
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * Increment_LastY --
+ *
+ *	Return the offset of the last vertical scroll increment.
+ *
+ * Results:
+ *	Pixel offset.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+Increment_LastY(
+    TreeDInfo dInfo		/* Display info. */
+    )
+{
+    IncrementRun *run = &dInfo->yIncrementRuns[dInfo->yIncrementRunCount - 1];
+
+    if (run->step == 0)
+	return dInfo->yScrollIncrements[run->first + run->count - 1];
+    return run->offset + (run->count - 1) * run->step;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * Increment_NewRunY --
+ *
+ *	Append a new empty IncrementRun to DInfo.yIncrementRuns.
+ *
+ * Results:
+ *	Pointer to the new run.
+ *
+ * Side effects:
+ *	Memory may be allocated.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static IncrementRun *
+Increment_NewRunY(
+    TreeDInfo dInfo,		/* Display info. */
+    int offset,			/* Offset of the first increment. */
+    int step			/* Distance between increments or zero. */
+    )
+{
+    IncrementRun *run;
+
+    if (dInfo->yIncrementRunCount == dInfo->yIncrementRunMax) {
+	dInfo->yIncrementRunMax = dInfo->yIncrementRunMax ?
+	    dInfo->yIncrementRunMax * 2 : 10;
+	dInfo->yIncrementRuns = (IncrementRun *) ckrealloc(
+	    (char *) dInfo->yIncrementRuns,
+	    dInfo->yIncrementRunMax * sizeof(IncrementRun));
+    }
+    run = &dInfo->yIncrementRuns[dInfo->yIncrementRunCount++];
+    run->index = dInfo->yScrollIncrementCount;
+    run->count = 0;
+    run->offset = offset;
+    run->step = step;
+    run->first = dInfo->yScrollIncrementUsed;
+    return run;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * Increment_AppendY --
+ *
+ *	Append a single value to the list of vertical scroll increments.
+ *	The value extends the last IncrementRun if it is evenly spaced
+ *	with it. Otherwise it is listed in DInfo.yScrollIncrements[],
+ *	and whenever the last few listed values turn out to be evenly
+ *	spaced they are moved into an IncrementRun of their own.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Memory may be allocated.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+Increment_AppendY(
+    TreeDInfo dInfo,		/* Display info. */
+    int offset			/* Offset to add. */
+    )
+{
+    IncrementRun *run = NULL;
+    int *v, step, i;
+
+    if (dInfo->yIncrementRunCount > 0) {
+	run = &dInfo->yIncrementRuns[dInfo->yIncrementRunCount - 1];
+	if ((run->step != 0) &&
+		(((run->count == 1) && (offset > run->offset)) ||
+		(offset - Increment_LastY(dInfo) == run->step))) {
+	    if (run->count == 1)
+		run->step = offset - run->offset;
+	    run->count++;
+	    dInfo->yScrollIncrementCount++;
+	    return;
+	}
+	if (run->step != 0)
+	    run = NULL;
+    }
+
+    if (run == NULL)
+	run = Increment_NewRunY(dInfo, offset, 0);
+    if (dInfo->yScrollIncrementUsed == dInfo->yScrollIncrementMax) {
+	dInfo->yScrollIncrementMax = dInfo->yScrollIncrementMax ?
+	    dInfo->yScrollIncrementMax * 2 : 10;
+	dInfo->yScrollIncrements = (int *) ckrealloc(
+	    (char *) dInfo->yScrollIncrements,
+	    dInfo->yScrollIncrementMax * sizeof(int));
+    }
+    dInfo->yScrollIncrements[dInfo->yScrollIncrementUsed++] = offset;
+    dInfo->yScrollIncrementCount++;
+    run->count++;
+
+    if (run->count < INCREMENT_RUN_MIN)
+	return;
+
+    /* Check if the last few listed offsets are evenly spaced. A step
+     * of zero (such as from zero-height items) marks a run of listed
+     * offsets, so those are never folded. */
+    v = dInfo->yScrollIncrements + dInfo->yScrollIncrementUsed -
+	INCREMENT_RUN_MIN;
+    step = v[1] - v[0];
+    if (step <= 0)
+	return;
+    for (i = 2; i < INCREMENT_RUN_MIN; i++) {
+	if (v[i] - v[i - 1] != step)
+	    return;
+    }
+
+    /* Move them into a new run. */
+    run->count -= INCREMENT_RUN_MIN;
+    dInfo->yScrollIncrementUsed -= INCREMENT_RUN_MIN;
+    dInfo->yScrollIncrementCount -= INCREMENT_RUN_MIN;
+    if (run->count == 0)
+	dInfo->yIncrementRunCount--;
+    run = Increment_NewRunY(dInfo, v[0], step);
+    run->count = INCREMENT_RUN_MIN;
+    dInfo->yScrollIncrementCount += INCREMENT_RUN_MIN;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * Increment_SetLastY --
+ *
+ *	Change the offset of the last vertical scroll increment.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Memory may be allocated.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+Increment_SetLastY(
+    TreeDInfo dInfo,		/* Display info. */
+    int offset			/* New offset of the last increment. */
+    )
+{
+    IncrementRun *run = &dInfo->yIncrementRuns[dInfo->yIncrementRunCount - 1];
+
+    if (run->step == 0) {
+	dInfo->yScrollIncrements[run->first + run->count - 1] = offset;
+	if (run->count == 1)
+	    run->offset = offset;
+	return;
+    }
+    run->count--;
+    dInfo->yScrollIncrementCount--;
+    if (run->count == 0)
+	dInfo->yIncrementRunCount--;
+    Increment_AppendY(dInfo, offset);
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -1022,7 +1349,7 @@ Increment_AddX(
  *	increments.
  *
  * Results:
- *	New size of DInfo.yScrollIncrements.
+ *	None.
  *
  * Side effects:
  *	Memory may be allocated.
@@ -1030,30 +1357,20 @@ Increment_AddX(
  *----------------------------------------------------------------------
  */
 
-static int
+static void
 Increment_AddY(
     TreeCtrl *tree,		/* Widget info. */
-    int offset,			/* Offset to add. */
-    int size			/* Current size of DInfo.yScrollIncrements. */
+    int offset			/* Offset to add. */
     )
 {
     TreeDInfo dInfo = tree->dInfo;
     int visHeight = Tree_ContentHeight(tree);
 
     while ((visHeight > 1) && (dInfo->yScrollIncrementCount > 0) &&
-	    (offset - dInfo->yScrollIncrements[dInfo->yScrollIncrementCount - 1]
-		    > visHeight)) {
-	size = Increment_AddY(tree,
-		dInfo->yScrollIncrements[dInfo->yScrollIncrementCount - 1] + visHeight,
-		size);
-    }
-    if (dInfo->yScrollIncrementCount + 1 > size) {
-	size *= 2;
-	dInfo->yScrollIncrements = (int *) ckrealloc(
-	    (char *) dInfo->yScrollIncrements, size * sizeof(int));
+	    (offset - Increment_LastY(dInfo) > visHeight)) {
+	Increment_AppendY(dInfo, Increment_LastY(dInfo) + visHeight);
     }
-    dInfo->yScrollIncrements[dInfo->yScrollIncrementCount++] = offset;
-    return size;
+    Increment_AppendY(dInfo, offset);
 }
 
 /*
@@ -1165,14 +1482,10 @@ RItemsToIncrementsY(
     int visHeight = Tree_ContentHeight(tree);
     int totalHeight = Tree_TotalHeight(tree);
     int y1, y2, y;
-    int size;
 
     if (totalHeight <= 0 /* dInfo->rangeFirst == NULL */)
 	return;
 
-    size = 10;
-    dInfo->yScrollIncrements = (int *) ckalloc(size * sizeof(int));
-
     /* If only locked columns are visible, we still scroll vertically. */
     rangeFirst = dInfo->rangeFirst;
     if (rangeFirst == NULL)
@@ -1183,14 +1496,14 @@ RItemsToIncrementsY(
 	 * top edge of each item. */
 	rItem = rangeFirst->first;
 	while (1) {
-	    size = Increment_AddY(tree, rItem->offset, size);
+	    Increment_AddY(tree, rItem->offset);
 	    if (rItem == rangeFirst->last)
 		break;
 	    rItem++;
 	}
     } else {
 	/* First increment is zero */
-	dInfo->yScrollIncrements[dInfo->yScrollIncrementCount++] = 0;
+	Increment_AppendY(dInfo, 0);
 
 	y1 = 0;
 	while (1) {
@@ -1207,16 +1520,16 @@ RItemsToIncrementsY(
 	    }
 	    if (y2 == totalHeight)
 		break;
-	    size = Increment_AddY(tree, y2, size);
+	    Increment_AddY(tree, y2);
 	    y1 = y2;
 	}
     }
 
-    if ((visHeight > 1) && (totalHeight -
-		dInfo->yScrollIncrements[dInfo->yScrollIncrementCount - 1] > visHeight)) {
-	size = Increment_AddY(tree, totalHeight, size);
-	dInfo->yScrollIncrementCount--;
-	dInfo->yScrollIncrements[dInfo->yScrollIncrementCount - 1] = totalHeight - visHeight;
+    if ((visHeight > 1) &&
+	    (totalHeight - Increment_LastY(dInfo) > visHeight)) {
+	while (totalHeight - Increment_LastY(dInfo) > visHeight)
+	    Increment_AppendY(dInfo, Increment_LastY(dInfo) + visHeight);
+	Increment_SetLastY(dInfo, totalHeight - visHeight);
     }
 }
 
@@ -1299,26 +1612,23 @@ RangesToIncrementsY(
     Range *range = dInfo->rangeFirst;
     int visHeight = Tree_ContentHeight(tree);
     int totalHeight = Tree_TotalHeight(tree);
-    int size;
 
     if (dInfo->rangeFirst == NULL)
 	return;
 
     /* First increment is zero */
-    size = 10;
-    dInfo->yScrollIncrements = (int *) ckalloc(size * sizeof(int));
-    dInfo->yScrollIncrements[dInfo->yScrollIncrementCount++] = 0;
+    Increment_AppendY(dInfo, 0);
 
     range = dInfo->rangeFirst->next;
     while (range != NULL) {
-	size = Increment_AddY(tree, range->offset, size);
+	Increment_AddY(tree, range->offset);
 	range = range->next;
     }
-    if ((visHeight > 1) && (totalHeight -
-		dInfo->yScrollIncrements[dInfo->yScrollIncrementCount - 1] > visHeight)) {
-	size = Increment_AddY(tree, totalHeight, size);
-	dInfo->yScrollIncrementCount--;
-	dInfo->yScrollIncrements[dInfo->yScrollIncrementCount - 1] = totalHeight - visHeight;
+    if ((visHeight > 1) &&
+	    (totalHeight - Increment_LastY(dInfo) > visHeight)) {
+	while (totalHeight - Increment_LastY(dInfo) > visHeight)
+	    Increment_AppendY(dInfo, Increment_LastY(dInfo) + visHeight);
+	Increment_SetLastY(dInfo, totalHeight - visHeight);
     }
 }
 
@@ -1356,6 +1666,11 @@ Increment_Redo(
     if (dInfo->yScrollIncrements != NULL)
 	ckfree((char *) dInfo->yScrollIncrements);
     dInfo->yScrollIncrements = NULL;
+    dInfo->yScrollIncrementUsed = dInfo->yScrollIncrementMax = 0;
+    if (dInfo->yIncrementRuns != NULL)
+	ckfree((char *) dInfo->yIncrementRuns);
+    dInfo->yIncrementRuns = NULL;
+    dInfo->yIncrementRunCount = dInfo->yIncrementRunMax = 0;
     dInfo->yScrollIncrementCount = 0;
 
     if (tree->vertical) {
@@ -1502,8 +1817,8 @@ B_IncrementFindX(
  *
  * B_IncrementFindY --
  *
- *	Search DInfo.yScrollIncrements and return one nearest to the
- *	given offset.
+ *	Search DInfo.yIncrementRuns and return the increment nearest to
+ *	the given offset.
  *
  * Results:
  *	Index of the nearest increment <= the given offset.
@@ -1522,11 +1837,40 @@ B_IncrementFindY(
     )
 {
     TreeDInfo dInfo = tree->dInfo;
+    IncrementRun *run;
+    int i, l, u, index;
 
-    return B_IncrementFind(
-	dInfo->yScrollIncrements,
-	dInfo->yScrollIncrementCount,
-	offset);
+    if (offset < 0)
+	offset = 0;
+
+    /* Binary search for the last run starting at or above offset */
+    l = 0;
+    u = dInfo->yIncrementRunCount - 1;
+    while (l <= u) {
+	i = (l + u) / 2;
+	run = &dInfo->yIncrementRuns[i];
+	if ((offset >= run->offset) &&
+		((i == dInfo->yIncrementRunCount - 1) ||
+		(offset < run[1].offset))) {
+	    if (run->step == 0) {
+		return run->index + B_IncrementFind(
+		    dInfo->yScrollIncrements + run->first,
+		    run->count,
+		    offset);
+	    }
+	    index = (offset - run->offset) / run->step;
+	    if (index > run->count - 1)
+		index = run->count - 1;
+	    return run->index + index;
+	}
+	if (offset < run->offset)
+	    u = i - 1;
+	else
+	    l = i + 1;
+    }
+    panic("B_IncrementFindY failed (count %d offset %d)",
+	dInfo->yScrollIncrementCount, offset);
+    return -1;
 }
 
 /*
@@ -2299,8 +2643,7 @@ Tree_RNCToItem(
     if (tree->vertical) {
 	if (col > dInfo->rangeLast->index)
 	    col = dInfo->rangeLast->index;
-	while (range->index != col)
-	    range = range->next;
+	range = dInfo->rangeArray[col];
 	rItem = range->last;
 	if (row > rItem->index)
 	    row = rItem->index;
@@ -2321,8 +2664,7 @@ Tree_RNCToItem(
     else {
 	if (row > dInfo->rangeLast->index)
 	    row = dInfo->rangeLast->index;
-	while (range->index != row)
-	    range = range->next;
+	range = dInfo->rangeArray[row];
 	rItem = range->last;
 	if (col > rItem->index)
 	    col = rItem->index;
@@ -2358,6 +2700,95 @@ DisplayDelay(TreeCtrl *tree)
     }
 }
 
+/*
+ *--------------------------------------------------------------
+ *
+ * DItem_AllocSlab --
+ *
+ *	Allocate a new block of DItems and add them to the pool of
+ *	unused DItems.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Memory is allocated.
+ *
+ *--------------------------------------------------------------
+ */
+
+static void
+DItem_AllocSlab(
+    TreeCtrl *tree		/* Widget info. */
+    )
+{
+    TreeDInfo dInfo = tree->dInfo;
+    DItemSlab *slab;
+    int i, count;
+
+    count = MAX(dInfo->dItemCount, DITEM_SLAB_MIN);
+    slab = (DItemSlab *) ckalloc(Tk_Offset(DItemSlab, dItems) +
+	count * sizeof(DItem));
+    slab->count = count;
+    slab->used = 0;
+    slab->free = NULL;
+    slab->next = dInfo->dItemSlabs;
+    dInfo->dItemSlabs = slab;
+    dInfo->dItemCount += count;
+
+    /* Push in reverse order so a new slab hands out its DItems in the
+     * order they sit in memory. Freed DItems are pushed back on top, so
+     * after scrolling the order is not kept. */
+    for (i = count - 1; i >= 0; i--) {
+	DItem *dItem = &slab->dItems[i];
+	dItem->slab = slab;
+	dItem->next = slab->free;
+	slab->free = dItem;
+    }
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * DItem_TrimSlabs --
+ *
+ *	Release blocks of DItems that are entirely unused. This is done
+ *	only when the pool holds more than twice as many DItems as are
+ *	currently in use, for example after the window shrinks.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Memory may be freed.
+ *
+ *--------------------------------------------------------------
+ */
+
+static void
+DItem_TrimSlabs(
+    TreeCtrl *tree		/* Widget info. */
+    )
+{
+    TreeDInfo dInfo = tree->dInfo;
+    DItemSlab *slab, **slabPtr;
+
+    if (dInfo->dItemCount <= MAX(dInfo->dItemUsed * 2, DITEM_SLAB_MIN))
+	return;
+
+    slabPtr = &dInfo->dItemSlabs;
+    while ((slab = *slabPtr) != NULL) {
+	if (slab->used == 0) {
+	    *slabPtr = slab->next;
+	    dInfo->dItemCount -= slab->count;
+	    WIPEFREE(slab, Tk_Offset(DItemSlab, dItems) +
+		slab->count * sizeof(DItem));
+	} else {
+	    slabPtr = &slab->next;
+	}
+    }
+}
+
 /*
  *--------------------------------------------------------------
  *
@@ -2384,20 +2815,35 @@ DItem_Alloc(
 {
     TreeDInfo dInfo = tree->dInfo;
     DItem *dItem;
+    DItemSlab *slab;
 
     dItem = (DItem *) TreeItem_GetDInfo(tree, rItem->item);
     if (dItem != NULL)
 	panic("tried to allocate duplicate DItem");
 
-    /* Pop unused DItem from stack */
-    if (dInfo->dItemFree != NULL) {
-	dItem = dInfo->dItemFree;
-	dInfo->dItemFree = dItem->next;
-    /* No free DItems, alloc a new one */
-    } else {
-	dItem = (DItem *) ckalloc(sizeof(DItem));
+    /* Take from the newest slab with unused DItems. It is usually the
+     * biggest, so the smaller ones are more likely to empty out and be
+     * released. There are only a few slabs since each doubles the
+     * pool. */
+    for (slab = dInfo->dItemSlabs; slab != NULL; slab = slab->next) {
+	if (slab->free != NULL)
+	    break;
+    }
+
+    /* No free DItems, alloc a new slab of them */
+    if (slab == NULL) {
+	DItem_AllocSlab(tree);
+	slab = dInfo->dItemSlabs;
     }
+
+    /* Pop unused DItem from stack */
+    dItem = slab->free;
+    slab->free = dItem->next;
     memset(dItem, '\0', sizeof(DItem));
+    dItem->slab = slab;
+    slab->used++;
+    dInfo->dItemUsed++;
+    TreePtrList_Append(&dInfo->dItemNew, (ClientData) dItem);
 #ifdef TREECTRL_DEBUG
     strncpy(dItem->magic, "MAGC", 4);
 #endif
@@ -2478,12 +2924,19 @@ DItem_Free(
 	panic("DItem_Free: dItem.magic != MAGC");
 #endif
     if (dItem->item != NULL) {
+	TreeItemList_Append(&dInfo->itemGone, dItem->item);
 	TreeItem_SetDInfo(tree, dItem->item, (TreeItemDInfo) NULL);
 	dItem->item = NULL;
     }
+    if (dItem->hits.rects != NULL) {
+	ckfree((char *) dItem->hits.rects);
+	dItem->hits.rects = NULL;
+    }
+    dItem->slab->used--;
+    dInfo->dItemUsed--;
     /* Push unused DItem on the stack */
-    dItem->next = dInfo->dItemFree;
-    dInfo->dItemFree = dItem;
+    dItem->next = dItem->slab->free;
+    dItem->slab->free = dItem;
     return next;
 }
 
@@ -2561,7 +3014,6 @@ Tree_ItemsInArea(
 				 * included in the area. */
     )
 {
-    TreeDInfo dInfo = tree->dInfo;
     int x, y, rx = 0, ry = 0, ix, iy, dx, dy;
     Range *range;
     RItem *rItem;
@@ -2569,31 +3021,24 @@ Tree_ItemsInArea(
     TreeItemList_Init(tree, items, 0);
 
     Range_RedoIfNeeded(tree);
-    range = dInfo->rangeFirst;
 
     if (tree->vertical) {
 	/* Find the first range which could be in the area horizontally */
-	while (range != NULL) {
-	    if ((range->offset < maxX) &&
-		    (range->offset + range->totalWidth >= minX)) {
-		rx = range->offset;
-		ry = 0;
-		break;
-	    }
-	    range = range->next;
-	}
+	range = Range_ByOffset(tree, minX);
+	if ((range != NULL) && (range->offset < maxX)) {
+	    rx = range->offset;
+	    ry = 0;
+	} else
+	    range = NULL;
     }
     else {
 	/* Find the first range which could be in the area vertically */
-	while (range != NULL) {
-	    if ((range->offset < maxY) &&
-		    (range->offset + range->totalHeight >= minY)) {
-		rx = 0;
-		ry = range->offset;
-		break;
-	    }
-	    range = range->next;
-	}
+	range = Range_ByOffset(tree, minY);
+	if ((range != NULL) && (range->offset < maxY)) {
+	    rx = 0;
+	    ry = range->offset;
+	} else
+	    range = NULL;
     }
 
     if (range == NULL)
@@ -2653,6 +3098,11 @@ Tree_ItemsInArea(
 #define DCOLUMN
 #ifdef DCOLUMN
 
+#define BITS_PER_LONG (sizeof(unsigned long) * 8)
+#define BIT_SET(b,n) ((b)[(n) / BITS_PER_LONG] |= 1UL << ((n) % BITS_PER_LONG))
+#define BIT_CLEAR(b,n) ((b)[(n) / BITS_PER_LONG] &= ~(1UL << ((n) % BITS_PER_LONG)))
+#define BIT_TEST(b,n) (((b)[(n) / BITS_PER_LONG] & (1UL << ((n) % BITS_PER_LONG))) != 0)
+
 /*
  *--------------------------------------------------------------
  *
@@ -2679,8 +3129,11 @@ GetOnScreenColumnsForItemAux(
     TreeColumnList *columns	/* Initialized list to append to. */
     )
 {
+    TreeDInfo dInfo = tree->dInfo;
     int minX, maxX, columnIndex = 0, x = 0, i, width;
+    int l, u;
     TreeColumn column = NULL, column2;
+    TreeColumnDInfo dColumn;
 
     minX = MAX(area->x, bounds[0]);
     maxX = MIN(area->x + area->width, bounds[2]);
@@ -2700,6 +3153,29 @@ GetOnScreenColumnsForItemAux(
 	    break;
     }
 
+    /* Binary search for the first column whose right edge is past minX.
+     * The offset of each column was recorded along with its width when
+     * the column widths were last checked. */
+    if ((dInfo->columnArrayCount == tree->columnCount) && (minX > 0)) {
+	l = TreeColumn_Index(column);
+	u = tree->columnCount - 1;
+	while (l < u) {
+	    i = (l + u) / 2;
+	    column2 = dInfo->columnArray[i];
+	    dColumn = TreeColumn_GetDInfo(column2);
+	    if ((TreeColumn_Lock(column2) != lock) ||
+		    (dColumn->offset + dColumn->width > minX))
+		u = i;
+	    else
+		l = i + 1;
+	}
+	/* Start at the first column of a span. */
+	if (dItem->spans != NULL)
+	    l = dItem->spans[l];
+	column = dInfo->columnArray[l];
+	x = TreeColumn_GetDInfo(column)->offset;
+    }
+
     for (columnIndex = TreeColumn_Index(column);
 	    columnIndex < tree->columnCount; columnIndex++) {
 	if (TreeColumn_Lock(column) != lock)
@@ -2796,10 +3272,12 @@ TrackOnScreenColumnsForItem(
     Tcl_HashEntry *hPtr		/* DInfo.itemVisHash entry. */
     )
 {
+    TreeDInfo dInfo = tree->dInfo;
     TreeColumnList columns;
     TreeColumn column, *value;
     DItem *dItem;
-    int i, j, count = 0, n = 0;
+    int i, j, count = 0, n = 0, words;
+    unsigned long *bitsNew, *bitsOld;
     Tcl_DString dString;
 
     TreeColumnList_Init(tree, &columns, 0);
@@ -2821,14 +3299,26 @@ TrackOnScreenColumnsForItem(
 	value[0] = NULL;
     }
 
+    /* Mark the new and old sets of columns in two bitsets indexed by
+     * column index. */
+    words = (tree->columnCount + BITS_PER_LONG - 1) / BITS_PER_LONG;
+    if (dInfo->columnBitsMax < words * 2) {
+	dInfo->columnBits = (unsigned long *) ckrealloc(
+	    (char *) dInfo->columnBits, words * 2 * sizeof(unsigned long));
+	memset(dInfo->columnBits, 0, words * 2 * sizeof(unsigned long));
+	dInfo->columnBitsMax = words * 2;
+    }
+    bitsNew = dInfo->columnBits;
+    bitsOld = dInfo->columnBits + words;
+    for (i = 0; i < count; i++)
+	BIT_SET(bitsNew, TreeColumn_Index(TreeColumnList_Nth(&columns, i)));
+    for (j = 0; value[j] != NULL; j++)
+	BIT_SET(bitsOld, TreeColumn_Index(value[j]));
+
     /* Track newly-visible columns */
     for (i = 0; i < count; i++) {
 	column = TreeColumnList_Nth(&columns, i);
-	for (j = 0; value[j] != NULL; j++) {
-	    if (column == value[j])
-		break;
-	}
-	if (value[j] == NULL) {
+	if (!BIT_TEST(bitsOld, TreeColumn_Index(column))) {
 	    if (tree->debug.enable && tree->debug.span)
 		DStringAppendf(&dString, " +%d", TreeColumn_GetID(column));
 	    n++;
@@ -2838,11 +3328,7 @@ TrackOnScreenColumnsForItem(
     /* Track newly-hidden columns */
     for (j = 0; value[j] != NULL; j++) {
 	column = value[j];
-	for (i = 0; i < count; i++) {
-	    if (TreeColumnList_Nth(&columns, i) == column)
-		break;
-	}
-	if (i == count) {
+	if (!BIT_TEST(bitsNew, TreeColumn_Index(column))) {
 	    TreeItemColumn itemColumn = TreeItem_FindColumn(tree, item,
 		TreeColumn_Index(column));
 	    if (itemColumn != NULL) {
@@ -2856,6 +3342,12 @@ TrackOnScreenColumnsForItem(
 	}
     }
 
+    /* Leave the bitsets cleared for next time. */
+    for (i = 0; i < count; i++)
+	BIT_CLEAR(bitsNew, TreeColumn_Index(TreeColumnList_Nth(&columns, i)));
+    for (j = 0; value[j] != NULL; j++)
+	BIT_CLEAR(bitsOld, TreeColumn_Index(value[j]));
+
     if (n && tree->debug.enable && tree->debug.span)
 	dbwin("%s\n", Tcl_DStringValue(&dString));
 
@@ -2909,7 +3401,7 @@ UpdateDInfoForRange(
     DItemArea *area;
     TreeItem item;
     int maxX, maxY;
-    int index, indexVis;
+    int index;
     int bgImgWidth, bgImgHeight;
 
     if (tree->backgroundImage != NULL)
@@ -2927,19 +3419,7 @@ UpdateDInfoForRange(
 	     * column widths. */
 	    (void) TreeItem_Height(tree, item);
 
-	    TreeItem_ToIndex(tree, item, &index, &indexVis);
-	    switch (tree->backgroundMode) {
-#ifdef DEPRECATED
-		case BG_MODE_INDEX:
-#endif
-		case BG_MODE_ORDER: break;
-#ifdef DEPRECATED
-		case BG_MODE_VISINDEX:
-#endif
-		case BG_MODE_ORDERVIS: index = indexVis; break;
-		case BG_MODE_COLUMN: index = range->index; break;
-		case BG_MODE_ROW: index = rItem->index; break;
-	    }
+	    index = GetItemBgIndex(tree, rItem, FALSE);
 
 	    dItem = (DItem *) TreeItem_GetDInfo(tree, item);
 
@@ -3041,19 +3521,7 @@ UpdateDInfoForRange(
 	     * column widths. */
 	    (void) TreeItem_Height(tree, item);
 
-	    TreeItem_ToIndex(tree, item, &index, &indexVis);
-	    switch (tree->backgroundMode) {
-#ifdef DEPRECATED
-		case BG_MODE_INDEX:
-#endif
-		case BG_MODE_ORDER: break;
-#ifdef DEPRECATED
-		case BG_MODE_VISINDEX:
-#endif
-		case BG_MODE_ORDERVIS: index = indexVis; break;
-		case BG_MODE_COLUMN: index = rItem->index; break;
-		case BG_MODE_ROW: index = range->index; break;
-	    }
+	    index = GetItemBgIndex(tree, rItem, TRUE);
 
 	    dItem = (DItem *) TreeItem_GetDInfo(tree, item);
 
@@ -3203,32 +3671,25 @@ Tree_UpdateDInfo(
     maxX = dInfo->bounds[2];
     maxY = dInfo->bounds[3];
 
-    range = dInfo->rangeFirst;
     if (tree->vertical) {
 	/* Find the first range which could be onscreen horizontally.
 	 * It may not be onscreen if it has less height than other ranges. */
-	while (range != NULL) {
-	    if ((range->offset < maxX + tree->xOrigin) &&
-		    (range->offset + range->totalWidth >= minX + tree->xOrigin)) {
-		rx = range->offset;
-		ry = 0;
-		break;
-	    }
-	    range = range->next;
-	}
+	range = Range_ByOffset(tree, minX + tree->xOrigin);
+	if ((range != NULL) && (range->offset < maxX + tree->xOrigin)) {
+	    rx = range->offset;
+	    ry = 0;
+	} else
+	    range = NULL;
     }
     else {
 	/* Find the first range which could be onscreen vertically.
 	 * It may not be onscreen if it has less width than other ranges. */
-	while (range != NULL) {
-	    if ((range->offset < maxY + tree->yOrigin) &&
-		    (range->offset + range->totalHeight >= minY + tree->yOrigin)) {
-		rx = 0;
-		ry = range->offset;
-		break;
-	    }
-	    range = range->next;
-	}
+	range = Range_ByOffset(tree, minY + tree->yOrigin);
+	if ((range != NULL) && (range->offset < maxY + tree->yOrigin)) {
+	    rx = 0;
+	    ry = range->offset;
+	} else
+	    range = NULL;
     }
 
     while (range != NULL) {
@@ -3288,7 +3749,7 @@ done:
 
     {
 	int y = Tree_ContentTop(tree) + tree->yOrigin; /* Window -> Canvas */
-	int index, indexVis;
+	int index;
 
 	/* If no non-locked columns are displayed, we have no Range and
 	 * must use dInfo->rangeLock. */
@@ -3312,19 +3773,7 @@ done:
 		dItem = DItem_Alloc(tree, rItem);
 	    }
 
-	    TreeItem_ToIndex(tree, rItem->item, &index, &indexVis);
-	    switch (tree->backgroundMode) {
-#ifdef DEPRECATED
-		case BG_MODE_INDEX:
-#endif
-		case BG_MODE_ORDER: break;
-#ifdef DEPRECATED
-		case BG_MODE_VISINDEX:
-#endif
-		case BG_MODE_ORDERVIS: index = indexVis; break;
-		case BG_MODE_COLUMN: index = range->index; break;
-		case BG_MODE_ROW: index = rItem->index; break;
-	    }
+	    index = GetItemBgIndex(tree, rItem, FALSE);
 
 	    dItem->y = y;
 	    dItem->height = rItem->size;
@@ -3594,6 +4043,44 @@ Range_RedoIfNeeded(
     }
 }
 
+#ifdef TREECTRL_BENCH
+
+/*
+ *--------------------------------------------------------------
+ *
+ * TreeDisplay_BenchRanges --
+ *
+ *	Rebuild the list of Ranges repeatedly for the
+ *	[treectrl::bench] command.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	The display is marked out-of-date and a redraw is scheduled,
+ *	the same as any other change to the Ranges.
+ *
+ *--------------------------------------------------------------
+ */
+
+void
+TreeDisplay_BenchRanges(
+    TreeCtrl *tree,		/* Widget info. */
+    int iterations		/* Number of times to rebuild. */
+    )
+{
+    TreeDInfo dInfo = tree->dInfo;
+    int i;
+
+    for (i = 0; i < iterations; i++) {
+	dInfo->flags |= DINFO_REDO_RANGES;
+	Range_RedoIfNeeded(tree);
+    }
+    Tree_EventuallyRedraw(tree);
+}
+
+#endif /* TREECTRL_BENCH */
+
 /*
  *--------------------------------------------------------------
  *
@@ -4407,25 +4894,72 @@ TreeRowProxy_Undisplay(
     }
 }
 
+/*
+ *--------------------------------------------------------------
+ *
+ * WhiteSpaceRect --
+ *
+ *	Append a rectangle to the list of whitespace rectangles being
+ *	calculated by CalcWhiteSpaceRegion().
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Memory may be allocated.
+ *
+ *--------------------------------------------------------------
+ */
+
+static void
+WhiteSpaceRect(
+    TreeDInfo dInfo,		/* Display info. */
+    int x, int y,		/* Top-left of the rectangle. */
+    int width, int height	/* Size of the rectangle. */
+    )
+{
+    XRectangle *rect;
+
+    if (dInfo->wsRectCountNew == dInfo->wsRectMax) {
+	dInfo->wsRectMax = dInfo->wsRectMax ? dInfo->wsRectMax * 2 : 8;
+	dInfo->wsRects = (XRectangle *) ckrealloc((char *) dInfo->wsRects,
+	    dInfo->wsRectMax * sizeof(XRectangle));
+	dInfo->wsRectsNew = (XRectangle *) ckrealloc(
+	    (char *) dInfo->wsRectsNew,
+	    dInfo->wsRectMax * sizeof(XRectangle));
+    }
+    rect = &dInfo->wsRectsNew[dInfo->wsRectCountNew++];
+    rect->x = x;
+    rect->y = y;
+    rect->width = width;
+    rect->height = height;
+}
+
 /*
  *--------------------------------------------------------------
  *
  * CalcWhiteSpaceRegion --
  *
- *	Create a new region containing all the whitespace of the list
+ *	Calculate the region containing all the whitespace of the list.
  *	The whitespace is the area inside the borders/header where items
  *	are not displayed.
  *
+ *	The whitespace is first gathered as a list of rectangles, which
+ *	depends only on the scroll origin, the content bounds, the size
+ *	of each Range and the column widths. If the list is the same as
+ *	the last time this was called then dInfo->wsRgnCalc is left
+ *	alone, otherwise it is rebuilt from the new rectangles.
+ *
  * Results:
- *	The new whitespace region, which may be empty.
+ *	Returns TRUE if dInfo->wsRgnCalc changed, FALSE otherwise.
  *
  * Side effects:
- *	A new region is allocated.
+ *	dInfo->wsRgnCalc may be rebuilt.
  *
  *--------------------------------------------------------------
  */
 
-static TkRegion
+static int
 CalcWhiteSpaceRegion(
     TreeCtrl *tree		/* Widget info. */
     )
@@ -4433,14 +4967,14 @@ CalcWhiteSpaceRegion(
     TreeDInfo dInfo = tree->dInfo;
     int x, y, minX, minY, maxX, maxY;
     int left, right, top, bottom;
-    TkRegion wsRgn;
-    XRectangle rect;
+    XRectangle *rects;
     Range *range;
+    int i;
 
     x = 0 - tree->xOrigin;
     y = 0 - tree->yOrigin;
 
-    wsRgn = Tree_GetRegion(tree);
+    dInfo->wsRectCountNew = 0;
 
     /* Erase area below left columns */
     if (!dInfo->emptyL) {
@@ -4449,11 +4983,8 @@ CalcWhiteSpaceRegion(
 	maxX = dInfo->boundsL[2];
 	maxY = dInfo->boundsL[3];
 	if (y + Tree_TotalHeight(tree) < maxY) {
-	    rect.x = minX;
-	    rect.y = y + Tree_TotalHeight(tree);
-	    rect.width = maxX - minX;
-	    rect.height = maxY - (y + Tree_TotalHeight(tree));
-	    TkUnionRectWithRegion(&rect, wsRgn, wsRgn);
+	    WhiteSpaceRect(dInfo, minX, y + Tree_TotalHeight(tree),
+		maxX - minX, maxY - (y + Tree_TotalHeight(tree)));
 	}
     }
 
@@ -4464,16 +4995,13 @@ CalcWhiteSpaceRegion(
 	maxX = dInfo->boundsR[2];
 	maxY = dInfo->boundsR[3];
 	if (y + Tree_TotalHeight(tree) < maxY) {
-	    rect.x = minX;
-	    rect.y = y + Tree_TotalHeight(tree);
-	    rect.width = maxX - minX;
-	    rect.height = maxY - (y + Tree_TotalHeight(tree));
-	    TkUnionRectWithRegion(&rect, wsRgn, wsRgn);
+	    WhiteSpaceRect(dInfo, minX, y + Tree_TotalHeight(tree),
+		maxX - minX, maxY - (y + Tree_TotalHeight(tree)));
 	}
     }
 
     if (dInfo->empty)
-	return wsRgn;
+	goto done;
 
     minX = dInfo->bounds[0];
     minY = dInfo->bounds[1];
@@ -4482,31 +5010,21 @@ CalcWhiteSpaceRegion(
 
     /* Only the header is visible. */
     if (dInfo->rangeFirst == NULL) {
-	rect.x = minX;
-	rect.y = minY;
-	rect.width = maxX - rect.x;
-	rect.height = maxY - rect.y;
-	TkUnionRectWithRegion(&rect, wsRgn, wsRgn);
-	return wsRgn;
+	WhiteSpaceRect(dInfo, minX, minY, maxX - minX, maxY - minY);
+	goto done;
     }
 
     if (tree->vertical) {
 	/* Erase area to right of last Range */
 	if (x + Tree_TotalWidth(tree) < maxX) {
-	    rect.x = x + Tree_TotalWidth(tree);
-	    rect.y = minY;
-	    rect.width = maxX - rect.x;
-	    rect.height = maxY - rect.y;
-	    TkUnionRectWithRegion(&rect, wsRgn, wsRgn);
+	    left = x + Tree_TotalWidth(tree);
+	    WhiteSpaceRect(dInfo, left, minY, maxX - left, maxY - minY);
 	}
     } else {
 	/* Erase area below last Range */
 	if (y + Tree_TotalHeight(tree) < maxY) {
-	    rect.x = minX;
-	    rect.y = y + Tree_TotalHeight(tree);
-	    rect.width = maxX - rect.x;
-	    rect.height = maxY - rect.y;
-	    TkUnionRectWithRegion(&rect, wsRgn, wsRgn);
+	    top = y + Tree_TotalHeight(tree);
+	    WhiteSpaceRect(dInfo, minX, top, maxX - minX, maxY - top);
 	}
     }
 
@@ -4521,11 +5039,7 @@ CalcWhiteSpaceRegion(
 
 	    /* Erase area below Range */
 	    if (top < bottom) {
-		rect.x = left;
-		rect.y = top;
-		rect.width = right - left;
-		rect.height = bottom - top;
-		TkUnionRectWithRegion(&rect, wsRgn, wsRgn);
+		WhiteSpaceRect(dInfo, left, top, right - left, bottom - top);
 	    }
 	} else {
 	    left = MAX(x + range->totalWidth, minX);
@@ -4535,17 +5049,33 @@ CalcWhiteSpaceRegion(
 
 	    /* Erase area to right of Range */
 	    if (left < right) {
-		rect.x = left;
-		rect.y = top;
-		rect.width = right - left;
-		rect.height = bottom - top;
-		TkUnionRectWithRegion(&rect, wsRgn, wsRgn);
+		WhiteSpaceRect(dInfo, left, top, right - left, bottom - top);
 	    }
 	}
 	if (range == dInfo->rangeLastD)
 	    break;
     }
-    return wsRgn;
+
+done:
+    /* Same rectangles as last time, so the region is unchanged. */
+    if ((dInfo->wsRectCountNew == dInfo->wsRectCount) &&
+	    ((dInfo->wsRectCount == 0) ||
+	    !memcmp(dInfo->wsRects, dInfo->wsRectsNew,
+		dInfo->wsRectCount * sizeof(XRectangle)))) {
+	return FALSE;
+    }
+
+    rects = dInfo->wsRects;
+    dInfo->wsRects = dInfo->wsRectsNew;
+    dInfo->wsRectsNew = rects;
+    dInfo->wsRectCount = dInfo->wsRectCountNew;
+
+    TkSubtractRegion(dInfo->wsRgnCalc, dInfo->wsRgnCalc, dInfo->wsRgnCalc);
+    for (i = 0; i < dInfo->wsRectCount; i++) {
+	TkUnionRectWithRegion(&dInfo->wsRects[i], dInfo->wsRgnCalc,
+	    dInfo->wsRgnCalc);
+    }
+    return TRUE;
 }
 
 #ifdef COMPLEX_WHITESPACE
@@ -4601,7 +5131,6 @@ Tree_IntersectRect(
  *
  *	Determine the index used to pick an -itembackground color
  *	for a displayed item.
- *	This is only valid for tree->vertical=1.
  *
  * Results:
  *	Integer index.
@@ -4615,7 +5144,11 @@ Tree_IntersectRect(
 static int
 GetItemBgIndex(
     TreeCtrl *tree,		/* Widget info. */
-    RItem *rItem		/* Range info for an item. */
+    RItem *rItem,		/* Range info for an item. */
+    int swap			/* TRUE if each Range is a row of items
+				 * instead of a column, which is true for
+				 * the unlocked columns when -orient is
+				 * horizontal. */
     )
 {
     Range *range = rItem->range;
@@ -4635,15 +5168,63 @@ GetItemBgIndex(
 	    index = indexVis;
 	    break;
 	case BG_MODE_COLUMN:
-	    index = range->index; /* always zero */
+	    index = swap ? rItem->index : range->index;
 	    break;
 	case BG_MODE_ROW:
-	    index = rItem->index;
+	    index = swap ? range->index : rItem->index;
 	    break;
     }
     return index;
 }
 
+/*
+ *--------------------------------------------------------------
+ *
+ * FlushStripes --
+ *
+ *	Fill a batch of rows of -itembackground color, issuing one
+ *	XFillRectangles call for each distinct color instead of one
+ *	XFillRectangle call for each row.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Stuff is drawn. The gcs[] array is overwritten.
+ *
+ *--------------------------------------------------------------
+ */
+
+#define STRIPE_BATCH 64
+
+static void
+FlushStripes(
+    TreeCtrl *tree,		/* Widget info. */
+    Drawable drawable,		/* Where to draw. */
+    XRectangle rects[],		/* Rows to fill. */
+    GC gcs[],			/* Color of each row. */
+    int numRects		/* Size of rects[] and gcs[]. */
+    )
+{
+    XRectangle same[STRIPE_BATCH];
+    GC gc;
+    int i, j, numSame;
+
+    for (i = 0; i < numRects; i++) {
+	if (gcs[i] == None)
+	    continue;
+	gc = gcs[i];
+	numSame = 0;
+	for (j = i; j < numRects; j++) {
+	    if (gcs[j] == gc) {
+		same[numSame++] = rects[j];
+		gcs[j] = None;
+	    }
+	}
+	XFillRectangles(tree->display, drawable, gc, same, numSame);
+    }
+}
+
 /*
  *--------------------------------------------------------------
  *
@@ -4679,6 +5260,9 @@ DrawColumnBackground(
     GC gc = None, backgroundGC;
     XRectangle dirtyBox, drawBox, rowBox;
     int top, bottom;
+    XRectangle rects[STRIPE_BATCH];
+    GC gcs[STRIPE_BATCH];
+    int numRects = 0;
 
     TkClipBox(dirtyRgn, &dirtyBox);
     if (!dirtyBox.width || !dirtyBox.height)
@@ -4710,16 +5294,18 @@ DrawColumnBackground(
 
 	if (Tree_IntersectRect(&drawBox, &rowBox, &dirtyBox)) {
 	    if (rItem != NULL) {
-		index = GetItemBgIndex(tree, rItem);
+		index = GetItemBgIndex(tree, rItem, FALSE);
 	    }
 	    gc = TreeColumn_BackgroundGC(treeColumn, index);
 	    if (gc == None)
 		gc = backgroundGC;
-	    XFillRectangle(tree->display, drawable, gc,
-		drawBox.x, drawBox.y, drawBox.width, drawBox.height);
+	    if (numRects == STRIPE_BATCH)
+		FlushStripes(tree, drawable, rects, gcs, numRects), numRects = 0;
+	    rects[numRects] = drawBox;
+	    gcs[numRects++] = gc;
 	}
 	if (rItem != NULL && rItem == rItem->range->last) {
-	    index = GetItemBgIndex(tree, rItem);
+	    index = GetItemBgIndex(tree, rItem, FALSE);
 	    rItem = NULL;
 	}
 	if (rItem != NULL) {
@@ -4728,6 +5314,7 @@ DrawColumnBackground(
 	index++;
 	top += rowBox.height;
     }
+    FlushStripes(tree, drawable, rects, gcs, numRects);
 }
 
 /*
@@ -4960,7 +5547,7 @@ DrawWhitespace(
 		    rItem = Range_ItemUnderPoint(tree, range, NULL, &y2);
 		    columnBox.y -= y2;
 		}
-		index = GetItemBgIndex(tree, rItem);
+		index = GetItemBgIndex(tree, rItem, FALSE);
 	    }
 	    columnBox.x = x + Tree_TotalWidth(tree);
 	    columnBox.width = maxX - columnBox.x;
@@ -4981,7 +5568,7 @@ DrawWhitespace(
 	    index = 0;
 	} else {
 	    rItem = range->last;
-	    index = GetItemBgIndex(tree, rItem);
+	    index = GetItemBgIndex(tree, rItem, FALSE);
 	    if (tree->backgroundMode != BG_MODE_COLUMN) {
 		index++;
 	    }
@@ -5083,6 +5670,256 @@ Tree_DrawTiledImage(
     };
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * Tree_DrawBackgroundImage --
+ *
+ *	Paint an area with the treectrl's -background color and then
+ *	the tiled -backgroundimage on top of it.
+ *
+ *	A pixmap holding the image tiled over the background color,
+ *	a whole number of tiles at least as big as the window, is kept
+ *	in dInfo->pixmapBg. The area is painted by copying from that
+ *	pixmap using tree->copyGC (so the caller may set a clip region)
+ *	instead of calling Tk_RedrawImage once for every tile.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Stuff is drawn. The pre-tiled pixmap may be (re)created.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+Tree_DrawBackgroundImage(
+    TreeCtrl *tree,		/* Widget info. */
+    Drawable drawable,		/* Where to draw. */
+    int x1, int y1,		/* Left & top of area to fill with the image. */
+    int x2, int y2,		/* Right & bottom, of area to fill with the
+				 * image. */
+    int xOffset, int yOffset	/* Used to keep the image aligned with an
+				 * origin. */
+    )
+{
+    TreeDInfo dInfo = tree->dInfo;
+    Tk_Window tkwin = tree->tkwin;
+    TreeDrawable *dPixmap = &dInfo->pixmapBg;
+    GC gc = Tk_3DBorderGC(tkwin, tree->border, TK_3D_FLAT_GC);
+    int imgWidth, imgHeight, width, height;
+    int srcX, srcY;
+    int srcW, srcH;
+    int dstX, dstY;
+
+    Tk_SizeOfImage(tree->backgroundImage, &imgWidth, &imgHeight);
+    if ((imgWidth <= 0) || (imgHeight <= 0)) {
+	XFillRectangle(tree->display, drawable, gc, x1, y1, x2 - x1, y2 - y1);
+	return;
+    }
+
+    width = imgWidth * (Tk_Width(tkwin) / imgWidth + 1);
+    height = imgHeight * (Tk_Height(tkwin) / imgHeight + 1);
+
+    if ((dPixmap->drawable != None) &&
+	    ((dPixmap->width != width) || (dPixmap->height != height))) {
+	Tk_FreePixmap(tree->display, dPixmap->drawable);
+	dPixmap->drawable = None;
+    }
+    if (dPixmap->drawable == None) {
+	dPixmap->drawable = Tk_GetPixmap(tree->display, Tk_WindowId(tkwin),
+		width, height, Tk_Depth(tkwin));
+	dPixmap->width = width;
+	dPixmap->height = height;
+
+	/* FIXME: only if backgroundImage is transparent */
+	XFillRectangle(tree->display, dPixmap->drawable, gc,
+		0, 0, width, height);
+	Tree_DrawTiledImage(tree, dPixmap->drawable, tree->backgroundImage,
+		0, 0, width, height, 0, 0);
+    }
+
+    /* Same as Tree_DrawTiledImage() except the "tile" is the whole
+     * pre-tiled pixmap. Since the pixmap is a whole number of tiles,
+     * only the first copy in each direction needs an offset. */
+    srcX = (x1 + xOffset) % imgWidth;
+    if (srcX < 0)
+	srcX += imgWidth;
+    dstX = x1;
+    while (dstX < x2) {
+	srcW = width - srcX;
+	if (dstX + srcW > x2) {
+	    srcW = x2 - dstX;
+	}
+
+	srcY = (y1 + yOffset) % imgHeight;
+	if (srcY < 0)
+	    srcY += imgHeight;
+	dstY = y1;
+	while (dstY < y2) {
+	    srcH = height - srcY;
+	    if (dstY + srcH > y2) {
+		srcH = y2 - dstY;
+	    }
+	    XCopyArea(tree->display, dPixmap->drawable, drawable,
+		    tree->copyGC, srcX, srcY, srcW, srcH, dstX, dstY);
+	    srcY = 0;
+	    dstY += srcH;
+	}
+	srcX = 0;
+	dstX += srcW;
+    }
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * Tree_InvalidateBackgroundImage --
+ *
+ *	Discard the pre-tiled -backgroundimage pixmap. Called when the
+ *	-background or -backgroundimage options change, when the window
+ *	is resized and when an image changes.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	A pixmap may be freed.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+Tree_InvalidateBackgroundImage(
+    TreeCtrl *tree		/* Widget info. */
+    )
+{
+    TreeDInfo dInfo = tree->dInfo;
+
+    if (dInfo->pixmapBg.drawable != None) {
+	Tk_FreePixmap(tree->display, dInfo->pixmapBg.drawable);
+	dInfo->pixmapBg.drawable = None;
+    }
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * DisplayLockedDItem --
+ *
+ *	Make sure the pixels for the left- or right-locked columns of an
+ *	item are up-to-date in dInfo->pixmapL or dInfo->pixmapR. The
+ *	cache pixmap is as wide as the locked columns and as tall as the
+ *	window; y-coordinates in the cache are window coordinates.
+ *
+ *	The whole area is redrawn if the cache is invalid or the item
+ *	moved vertically. If only some locked columns changed, only
+ *	the dirty part is redrawn. If nothing changed (the area was
+ *	merely exposed or copied over) nothing is drawn.
+ *
+ * Results:
+ *	The cache pixmap.
+ *
+ * Side effects:
+ *	Stuff may be drawn. The cache pixmap may be reallocated, in which
+ *	case the cached pixels of every other item are discarded.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static Pixmap
+DisplayLockedDItem(
+    TreeCtrl *tree,		/* Widget info. */
+    DItem *dItem,
+    DItemArea *area,		/* dItem->left or dItem->right. */
+    int lock,			/* COLUMN_LOCK_LEFT or COLUMN_LOCK_RIGHT. */
+    int flags,			/* area->flags before drawing started. */
+    int left, int right		/* Dirty horizontal span, window coords. */
+    )
+{
+    TreeDInfo dInfo = tree->dInfo;
+    Tk_Window tkwin = tree->tkwin;
+    TreeDrawable *dPixmap, td;
+    DItem *dItem2;
+    int width, height = Tk_Height(tkwin);
+    int minX = 0, maxX = 0;
+
+    if (lock == COLUMN_LOCK_LEFT) {
+	dPixmap = &dInfo->pixmapL;
+	width = dInfo->widthOfColumnsLeft;
+    } else {
+	dPixmap = &dInfo->pixmapR;
+	width = dInfo->widthOfColumnsRight;
+    }
+
+    if ((dPixmap->drawable == None) || (dPixmap->width != width) ||
+	    (dPixmap->height != height)) {
+	if (dPixmap->drawable != None)
+	    Tk_FreePixmap(tree->display, dPixmap->drawable);
+	dPixmap->drawable = Tk_GetPixmap(tree->display,
+		Tk_WindowId(tkwin), width, height, Tk_Depth(tkwin));
+	dPixmap->width = width;
+	dPixmap->height = height;
+
+	/* The cached pixels of every item are gone. */
+	for (dItem2 = dInfo->dItem; dItem2 != NULL; dItem2 = dItem2->next) {
+	    if (lock == COLUMN_LOCK_LEFT)
+		dItem2->left.flags &= ~DITEM_CACHED;
+	    else
+		dItem2->right.flags &= ~DITEM_CACHED;
+	}
+    }
+
+    if (!(area->flags & DITEM_CACHED) ||
+	    (flags & DITEM_ALL_DIRTY) ||
+	    (area->cacheY != dItem->y) ||
+	    (area->cacheHeight != dItem->height)) {
+	minX = 0;
+	maxX = area->width;
+    } else if (flags & DITEM_CACHE_DIRTY) {
+	minX = left - area->x;
+	maxX = right - area->x;
+    }
+
+    if (minX < maxX) {
+	td = *dPixmap;
+
+	/* Other items whose cached rows are drawn over lose their cache. */
+	for (dItem2 = dInfo->dItem; dItem2 != NULL; dItem2 = dItem2->next) {
+	    DItemArea *area2;
+
+	    if (dItem2 == dItem)
+		continue;
+	    area2 = (lock == COLUMN_LOCK_LEFT) ? &dItem2->left : &dItem2->right;
+	    if (!(area2->flags & DITEM_CACHED))
+		continue;
+	    if ((area2->cacheY < dItem->y + dItem->height) &&
+		    (area2->cacheY + area2->cacheHeight > dItem->y))
+		area2->flags &= ~DITEM_CACHED;
+	}
+
+	/* The top-left corner of the drawable is at this
+	* point in the canvas */
+	tree->drawableXOrigin = area->x + tree->xOrigin;
+	tree->drawableYOrigin = tree->yOrigin;
+
+	TreeItem_Draw(tree, dItem->item, lock,
+		0, dItem->y,
+		area->width, dItem->height,
+		td,
+		minX, maxX,
+		dItem->index);
+    }
+
+    area->flags |= DITEM_CACHED;
+    area->flags &= ~DITEM_CACHE_DIRTY;
+    area->cacheY = dItem->y;
+    area->cacheHeight = dItem->height;
+
+    return dPixmap->drawable;
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -5112,6 +5949,7 @@ DisplayDItem(
 {
     Tk_Window tkwin = tree->tkwin;
     int left, top, right, bottom;
+    int flags = area->flags;
 
     left = area->x;
     right = left + area->width;
@@ -5151,11 +5989,30 @@ DisplayDItem(
 	    DblBufWinDirty(tree, left, top, right, bottom);
 	}
 
+	/* Locked columns don't move when scrolling horizontally, so their
+	 * pixels are kept around and copied from the cache unless the
+	 * item content changed. */
+	if (lock != COLUMN_LOCK_NONE) {
+	    Pixmap cache = DisplayLockedDItem(tree, dItem, area, lock,
+		    flags, left, right);
+	    XCopyArea(tree->display, cache, drawable.drawable,
+		    tree->copyGC,
+		    left - area->x, top,
+		    right - left, bottom - top,
+		    left, top);
+	    return 1;
+	}
+
 	/* The top-left corner of the drawable is at this
 	* point in the canvas */
 	tree->drawableXOrigin = left + tree->xOrigin;
 	tree->drawableYOrigin = top + tree->yOrigin;
 
+	/* Only the dirty part of the pixmap is copied to the window, so
+	 * elements outside it aren't drawn. */
+	pixmap.width = right - left;
+	pixmap.height = bottom - top;
+
 	TreeItem_Draw(tree, dItem->item, lock,
 		area->x - left, dItem->y - top,
 		area->width, dItem->height,
@@ -5356,6 +6213,7 @@ Tree_Display(
 #endif
     XRectangle wsBox;
     int requests;
+    int trackColumns;
 
     if (tree->debug.enable && tree->debug.display && 0)
 	dbwin("Tree_Display %s\n", Tk_PathName(tkwin));
@@ -5369,6 +6227,10 @@ Tree_Display(
     Tcl_Preserve((ClientData) tree);
     Tree_PreserveItems(tree);
 
+    /* Don't draw the old text of elements whose -textvariable was
+     * written. */
+    TreeElement_UpdateTextVars(tree);
+
 displayRetry:
 
     /* Some change requires selection changes */
@@ -5395,7 +6257,16 @@ displayRetry:
 	/* Set max -itembackground as well. */
 	tree->columnBgCnt = 0;
 
+	if (dInfo->columnArrayMax < tree->columnCount) {
+	    dInfo->columnArrayMax = tree->columnCount;
+	    dInfo->columnArray = (TreeColumn *) ckrealloc(
+		(char *) dInfo->columnArray,
+		dInfo->columnArrayMax * sizeof(TreeColumn));
+	}
+	dInfo->columnArrayCount = 0;
+
 	while (treeColumn != NULL) {
+	    dInfo->columnArray[dInfo->columnArrayCount++] = treeColumn;
 	    offset = TreeColumn_Offset(treeColumn);
 	    width = TreeColumn_UseWidth(treeColumn);
 	    dColumn = TreeColumn_GetDInfo(treeColumn);
@@ -5526,6 +6397,14 @@ displayRetry:
     if (TreeDisplay_WasThereTrouble(tree, requests)) {
 	goto displayRetry;
     }
+    /* The onscreen columns of items that stayed onscreen can only change
+     * if the columns moved or the items moved sideways. Items only move
+     * sideways without the columns moving when there is more than one
+     * Range. This is checked before Tree_UpdateDInfo() since that
+     * clears DINFO_INVALIDATE. */
+    trackColumns = (dInfo->flags & DINFO_INVALIDATE) ||
+	(dInfo->xOrigin != tree->xOrigin) ||
+	!tree->vertical || (tree->wrapMode != TREE_WRAP_NONE);
     if (dInfo->flags & DINFO_OUT_OF_DATE) {
 	Tree_UpdateDInfo(tree);
 	dInfo->flags &= ~DINFO_OUT_OF_DATE;
@@ -5544,52 +6423,73 @@ displayRetry:
      * item must be hidden. An item may become hidden because of scrolling,
      * or because an ancestor was collapsed, or because the -visible option
      * of the item changed.
+     *
+     * An item can only come onscreen by getting a DItem and only go
+     * offscreen by losing one, so only the items in dInfo->dItemNew and
+     * dInfo->itemGone need checking, not every onscreen item.
      */
     {
 	Tcl_HashEntry *hPtr;
-	Tcl_HashSearch search;
 	TreeItemList newV, newH;
 	TreeItem item;
-	int isNew, i, count;
+	int isNew, i, count, notify;
+
+	/* Don't bother building the lists if nobody is listening. */
+	notify = TreeNotify_WantItemVisibility(tree);
 
 	TreeItemList_Init(tree, &newV, 0);
 	TreeItemList_Init(tree, &newH, 0);
 
-	for (dItem = dInfo->dItem;
-	    dItem != NULL;
-	    dItem = dItem->next) {
-
-	    hPtr = Tcl_FindHashEntry(&dInfo->itemVisHash, (char *) dItem->item);
-	    if (hPtr == NULL) {
+	/* A DItem that has been freed again since it was allocated has
+	 * no item, or may belong to a different item by now. Both are
+	 * fine. */
+	count = dInfo->dItemNew.count;
+	for (i = 0; i < count; i++) {
+	    dItem = (DItem *) dInfo->dItemNew.pointers[i];
+	    if (dItem->item == NULL)
+		continue;
+	    hPtr = Tcl_CreateHashEntry(&dInfo->itemVisHash,
+		(char *) dItem->item, &isNew);
+	    if (isNew) {
 		/* This item is now visible, wasn't before */
-		TreeItemList_Append(&newV, dItem->item);
+		if (notify)
+		    TreeItemList_Append(&newV, dItem->item);
 		TreeItem_OnScreen(tree, dItem->item, TRUE);
 	    }
 #ifdef DCOLUMN
-	    /* The item was onscreen and still is. Figure out which
-	     * item-columns have become visible or hidden. */
-	    else {
+	    if (!trackColumns)
 		TrackOnScreenColumnsForItem(tree, dItem->item, hPtr);
-	    }
 #endif /* DCOLUMN */
 	}
 
-	hPtr = Tcl_FirstHashEntry(&dInfo->itemVisHash, &search);
-	while (hPtr != NULL) {
-	    item = (TreeItem) Tcl_GetHashKey(&dInfo->itemVisHash, hPtr);
-	    if (TreeItem_GetDInfo(tree, item) == NULL) {
-		/* This item was visible but isn't now */
-		TreeItemList_Append(&newH, item);
-		TreeItem_OnScreen(tree, item, FALSE);
+#ifdef DCOLUMN
+	/* The item was onscreen and still is. Figure out which
+	 * item-columns have become visible or hidden. */
+	if (trackColumns) {
+	    for (dItem = dInfo->dItem;
+		dItem != NULL;
+		dItem = dItem->next) {
+		hPtr = Tcl_FindHashEntry(&dInfo->itemVisHash,
+		    (char *) dItem->item);
+		if (hPtr != NULL)
+		    TrackOnScreenColumnsForItem(tree, dItem->item, hPtr);
 	    }
-	    hPtr = Tcl_NextHashEntry(&search);
 	}
+#endif /* DCOLUMN */
 
-	/* Remove newly-hidden items from itemVisHash */
-	count = TreeItemList_Count(&newH);
+	/* Deleted items were removed from itemVisHash by
+	 * TreeDisplay_ItemDeleted(), so the item is only looked at if it
+	 * is still in the table. */
+	count = TreeItemList_Count(&dInfo->itemGone);
 	for (i = 0; i < count; i++) {
-	    item = TreeItemList_Nth(&newH, i);
+	    item = TreeItemList_Nth(&dInfo->itemGone, i);
 	    hPtr = Tcl_FindHashEntry(&dInfo->itemVisHash, (char *) item);
+	    if ((hPtr == NULL) || (TreeItem_GetDInfo(tree, item) != NULL))
+		continue;
+	    /* This item was visible but isn't now */
+	    if (notify)
+		TreeItemList_Append(&newH, item);
+	    TreeItem_OnScreen(tree, item, FALSE);
 #ifdef DCOLUMN
 	    TrackOnScreenColumnsForItem(tree, item, hPtr);
 	    ckfree((char *) Tcl_GetHashValue(hPtr));
@@ -5597,15 +6497,11 @@ displayRetry:
 	    Tcl_DeleteHashEntry(hPtr);
 	}
 
-	/* Add newly-visible items to itemVisHash */
-	count = TreeItemList_Count(&newV);
-	for (i = 0; i < count; i++) {
-	    item = TreeItemList_Nth(&newV, i);
-	    hPtr = Tcl_CreateHashEntry(&dInfo->itemVisHash, (char *) item, &isNew);
-#ifdef DCOLUMN
-	    TrackOnScreenColumnsForItem(tree, item, hPtr);
-#endif /* DCOLUMN */
-	}
+	TreePtrList_Free(&dInfo->dItemNew);
+	TreePtrList_Init(tree, &dInfo->dItemNew, 0);
+	TreeItemList_Free(&dInfo->itemGone);
+	TreeItemList_Init(tree, &dInfo->itemGone, 0);
+	DItem_TrimSlabs(tree);
 
 	/*
 	 * Generate an <ItemVisibility> event here. This can be used to set
@@ -5678,11 +6574,20 @@ displayRetry:
 
     if (dInfo->flags & DINFO_DRAW_WHITESPACE) {
 	TkSubtractRegion(dInfo->wsRgn, dInfo->wsRgn, dInfo->wsRgn);
+	dInfo->wsRgnCurrent = FALSE;
 	dInfo->flags &= ~DINFO_DRAW_WHITESPACE;
     }
 
-    if (tree->backgroundImage != NULL) {
-	wsRgnNew = CalcWhiteSpaceRegion(tree);
+    /* When the whitespace region hasn't changed and nothing has been
+     * invalidated since it was last drawn, there is nothing to do. */
+    if (CalcWhiteSpaceRegion(tree))
+	dInfo->wsRgnCurrent = FALSE;
+
+    if ((tree->backgroundImage != NULL) && (!dInfo->wsRgnCurrent ||
+	    dInfo->xOrigin != tree->xOrigin ||
+	    dInfo->yOrigin != tree->yOrigin)) {
+	wsRgnNew = Tree_GetRegion(tree);
+	TkIntersectRegion(dInfo->wsRgnCalc, dInfo->wsRgnCalc, wsRgnNew);
 
 	/* If we scrolled, redraw entire whitespace area */
 	if (dInfo->xOrigin != tree->xOrigin ||
@@ -5694,38 +6599,20 @@ displayRetry:
 	}
 	TkClipBox(wsRgnDif, &wsBox);
 	if ((wsBox.width > 0) && (wsBox.height > 0)) {
-	    Drawable pixmap = Tk_GetPixmap(tree->display, Tk_WindowId(tkwin),
-		    wsBox.width, wsBox.height, Tk_Depth(tkwin));
-	    GC gc = Tk_3DBorderGC(tkwin, tree->border, TK_3D_FLAT_GC);
-
 	    if (tree->debug.enable && tree->debug.display && tree->debug.drawColor) {
 		Tree_FillRegion(tree->display, Tk_WindowId(tkwin),
 			tree->debug.gcDraw, wsRgnDif);
 		DisplayDelay(tree);
 	    }
 
-	    /* FIXME: only if backgroundImage is transparent */
-	    Tree_OffsetRegion(wsRgnDif, -wsBox.x, -wsBox.y);
-	    Tree_FillRegion(tree->display, pixmap, gc, wsRgnDif);
-	    Tree_OffsetRegion(wsRgnDif, wsBox.x, wsBox.y);
-
-/*	    tree->drawableXOrigin = tree->xOrigin + wsBox.x;
-	    tree->drawableYOrigin = tree->yOrigin + wsBox.y;*/
-
-	    Tree_DrawTiledImage(tree, pixmap, tree->backgroundImage,
-		    0, 0, wsBox.width, wsBox.height,
-		    tree->xOrigin + wsBox.x, tree->yOrigin + wsBox.y);
-
+	    /* Copy straight from the pre-tiled image, clipped to the
+	     * whitespace region. */
 	    TkSetRegion(tree->display, tree->copyGC, wsRgnNew);
-/*			XSetClipOrigin(tree->display, tree->copyGC, 0,
-			0);*/
-	    XCopyArea(tree->display, pixmap, drawable, tree->copyGC,
-		    0, 0, wsBox.width, wsBox.height,
-		    wsBox.x, wsBox.y);
+	    Tree_DrawBackgroundImage(tree, drawable,
+		    wsBox.x, wsBox.y,
+		    wsBox.x + wsBox.width, wsBox.y + wsBox.height,
+		    tree->xOrigin, tree->yOrigin);
 	    XSetClipMask(tree->display, tree->copyGC, None);
-/*			XSetClipOrigin(tree->display, tree->copyGC, 0, 0);*/
-
-	    Tk_FreePixmap(tree->display, pixmap);
 
 	    if (tree->doubleBuffer == DOUBLEBUFFER_WINDOW) {
 		DblBufWinDirty(tree, wsBox.x, wsBox.y, wsBox.x + wsBox.width,
@@ -5736,6 +6623,7 @@ displayRetry:
 	    Tree_FreeRegion(tree, wsRgnDif);
 	Tree_FreeRegion(tree, dInfo->wsRgn);
 	dInfo->wsRgn = wsRgnNew;
+	dInfo->wsRgnCurrent = TRUE;
     }
 
     dInfo->xOrigin = tree->xOrigin;
@@ -5744,10 +6632,11 @@ displayRetry:
     /* Does this need to be here? */
     dInfo->flags &= ~(DINFO_REDRAW_PENDING);
 
-    if (tree->backgroundImage == NULL) {
-	/* Calculate the current whitespace region, subtract the old whitespace
+    if ((tree->backgroundImage == NULL) && !dInfo->wsRgnCurrent) {
+	/* Take the current whitespace region, subtract the old whitespace
 	 * region, and fill the difference with the background color. */
-	wsRgnNew = CalcWhiteSpaceRegion(tree);
+	wsRgnNew = Tree_GetRegion(tree);
+	TkIntersectRegion(dInfo->wsRgnCalc, dInfo->wsRgnCalc, wsRgnNew);
 	wsRgnDif = Tree_GetRegion(tree);
 	TkSubtractRegion(wsRgnNew, dInfo->wsRgn, wsRgnDif);
 	TkClipBox(wsRgnDif, &wsBox);
@@ -5773,6 +6662,7 @@ displayRetry:
 	Tree_FreeRegion(tree, wsRgnDif);
 	Tree_FreeRegion(tree, dInfo->wsRgn);
 	dInfo->wsRgn = wsRgnNew;
+	dInfo->wsRgnCurrent = TRUE;
     }
 
     /* See if there are any dirty items */
@@ -5945,6 +6835,440 @@ displayExit:
     Tcl_Release((ClientData) tree);
 }
 
+/*
+ *--------------------------------------------------------------
+ *
+ * RenderItems --
+ *
+ *	Draw every item overlapping one of the item areas of the
+ *	window into a window-sized drawable. This does not use or
+ *	change the DItem list, so the area may be a view that is
+ *	not on the screen.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Stuff is drawn.
+ *
+ *--------------------------------------------------------------
+ */
+
+static void
+RenderItems(
+    TreeCtrl *tree,		/* Widget info. */
+    TreeDrawable td,		/* Where to draw. */
+    int lock,			/* Which set of columns. */
+    int bounds[4]		/* TREE_AREA_xxx bounds of drawing. */
+    )
+{
+    TreeDInfo dInfo = tree->dInfo;
+    TreeItemList items;
+    TreeItem item;
+    Range *range;
+    RItem *rItem;
+    int i, x, y, w, h, index;
+    int swap = !tree->vertical && (lock == COLUMN_LOCK_NONE);
+
+    if (lock == COLUMN_LOCK_NONE) {
+	Tree_ItemsInArea(tree, &items,
+		bounds[0] + tree->xOrigin, bounds[1] + tree->yOrigin,
+		bounds[2] + tree->xOrigin, bounds[3] + tree->yOrigin);
+    } else {
+	TreeItemList_Init(tree, &items, 0);
+
+	/* If no non-locked columns are displayed, we have no Range and
+	 * must use dInfo->rangeLock. */
+	range = dInfo->rangeFirst;
+	if (range == NULL)
+	    range = dInfo->rangeLock;
+
+	y = bounds[1] + tree->yOrigin; /* Window -> Canvas */
+	if ((range != NULL) && (y >= 0) && (y < range->totalHeight)) {
+	    rItem = Range_ItemUnderPoint(tree, range, NULL, &y);
+	    y = rItem->offset - tree->yOrigin; /* Canvas -> Window */
+	    while (1) {
+		TreeItemList_Append(&items, rItem->item);
+		if (rItem == range->last)
+		    break;
+		y += rItem->size;
+		if (y >= bounds[3])
+		    break;
+		rItem++;
+	    }
+	}
+    }
+
+    /* The top-left corner of the drawable is at this point in the
+     * canvas */
+    tree->drawableXOrigin = tree->xOrigin;
+    tree->drawableYOrigin = tree->yOrigin;
+
+    for (i = 0; i < TreeItemList_Count(&items); i++) {
+	item = TreeItemList_Nth(&items, i);
+	if (Tree_ItemBbox(tree, item, lock, &x, &y, &w, &h) < 0)
+	    continue;
+	rItem = (RItem *) TreeItem_GetRInfo(tree, item);
+	index = GetItemBgIndex(tree, rItem, swap);
+
+	/* Canvas -> Window */
+	TreeItem_Draw(tree, item, lock,
+		x - tree->xOrigin, y - tree->yOrigin, w, h,
+		td, bounds[0], bounds[2], index);
+    }
+
+    TreeItemList_Free(&items);
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * RenderView --
+ *
+ *	Draw the whole window as it would appear with the current
+ *	scroll position into a window-sized drawable: background,
+ *	items, header and borders.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Stuff is drawn.
+ *
+ *--------------------------------------------------------------
+ */
+
+static void
+RenderView(
+    TreeCtrl *tree,		/* Widget info. */
+    TreeDrawable td		/* Where to draw. */
+    )
+{
+    TreeDInfo dInfo = tree->dInfo;
+    Tk_Window tkwin = tree->tkwin;
+    Drawable drawable = td.drawable;
+    TkRegion rgn;
+    XRectangle rect;
+    int minX, minY, maxX, maxY;
+    GC gc = Tk_3DBorderGC(tkwin, tree->border, TK_3D_FLAT_GC);
+
+    XFillRectangle(tree->display, drawable, gc, 0, 0, td.width, td.height);
+
+    /* Paint the background of every item area, then draw the items
+     * on top of it. Anything the items don't cover is whitespace. */
+    rgn = Tree_GetRegion(tree);
+    if (!dInfo->empty) {
+	rect.x = dInfo->bounds[0];
+	rect.y = dInfo->bounds[1];
+	rect.width = dInfo->bounds[2] - dInfo->bounds[0];
+	rect.height = dInfo->bounds[3] - dInfo->bounds[1];
+	TkUnionRectWithRegion(&rect, rgn, rgn);
+    }
+    if (!dInfo->emptyL) {
+	rect.x = dInfo->boundsL[0];
+	rect.y = dInfo->boundsL[1];
+	rect.width = dInfo->boundsL[2] - dInfo->boundsL[0];
+	rect.height = dInfo->boundsL[3] - dInfo->boundsL[1];
+	TkUnionRectWithRegion(&rect, rgn, rgn);
+    }
+    if (!dInfo->emptyR) {
+	rect.x = dInfo->boundsR[0];
+	rect.y = dInfo->boundsR[1];
+	rect.width = dInfo->boundsR[2] - dInfo->boundsR[0];
+	rect.height = dInfo->boundsR[3] - dInfo->boundsR[1];
+	TkUnionRectWithRegion(&rect, rgn, rgn);
+    }
+    TkClipBox(rgn, &rect);
+    if ((rect.width > 0) && (rect.height > 0)) {
+	if (tree->backgroundImage != NULL) {
+	    TkSetRegion(tree->display, tree->copyGC, rgn);
+	    Tree_DrawBackgroundImage(tree, drawable,
+		    rect.x, rect.y,
+		    rect.x + rect.width, rect.y + rect.height,
+		    tree->xOrigin, tree->yOrigin);
+	    XSetClipMask(tree->display, tree->copyGC, None);
+	}
+#ifdef COMPLEX_WHITESPACE
+	else {
+	    DrawWhitespace(tree, drawable, rgn);
+	}
+#endif
+    }
+    Tree_FreeRegion(tree, rgn);
+
+    if (!dInfo->empty && dInfo->rangeFirst != NULL)
+	RenderItems(tree, td, COLUMN_LOCK_NONE, dInfo->bounds);
+    if (!dInfo->emptyL)
+	RenderItems(tree, td, COLUMN_LOCK_LEFT, dInfo->boundsL);
+    if (!dInfo->emptyR)
+	RenderItems(tree, td, COLUMN_LOCK_RIGHT, dInfo->boundsR);
+
+    if (Tree_AreaBbox(tree, TREE_AREA_HEADER, &minX, &minY, &maxX, &maxY))
+	Tree_DrawHeader(tree, td, 0 - tree->xOrigin, Tree_HeaderTop(tree));
+
+    if (tree->useTheme && TreeTheme_DrawBorders(tree, drawable) == TCL_OK) {
+	/* nothing */
+    } else {
+	if (tree->highlightWidth > 0) {
+	    GC fgGC, bgGC;
+
+	    bgGC = Tk_GCForColor(tree->highlightBgColorPtr, drawable);
+	    if (tree->gotFocus)
+		fgGC = Tk_GCForColor(tree->highlightColorPtr, drawable);
+	    else
+		fgGC = bgGC;
+	    TkpDrawHighlightBorder(tkwin, fgGC, bgGC, tree->highlightWidth,
+		    drawable);
+	}
+	if (tree->borderWidth > 0) {
+	    Tk_Draw3DRectangle(tkwin, drawable, tree->border,
+		    tree->highlightWidth, tree->highlightWidth,
+		    Tk_Width(tkwin) - tree->highlightWidth * 2,
+		    Tk_Height(tkwin) - tree->highlightWidth * 2,
+		    tree->borderWidth, tree->relief);
+	}
+    }
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * RenderCopy --
+ *
+ *	Copy some rows of a drawable filled by RenderView() into a
+ *	photo image. Only the part of the rows inside the requested
+ *	region is copied.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	The photo image is updated.
+ *
+ *--------------------------------------------------------------
+ */
+
+static void
+RenderCopy(
+    TreeCtrl *tree,		/* Widget info. */
+    Tk_PhotoHandle photoH,	/* Photo image to copy into. */
+    TreeDrawable td,		/* Drawable to copy from. */
+    int srcTop, int srcBottom,	/* Rows of the drawable to copy. */
+    int destTop,		/* Where srcTop is in the rendered image. */
+    int region[4]		/* Part of the rendered image wanted in
+				 * the photo. */
+    )
+{
+    XImage *ximage;
+    int top, bottom;
+
+    top = MAX(destTop, region[1]);
+    bottom = MIN(destTop + (srcBottom - srcTop), region[3]);
+    if (top >= bottom)
+	return;
+
+    ximage = Tree_XGetImage(tree->tkwin, td.drawable,
+	    region[0], srcTop + (top - destTop),
+	    region[2] - region[0], bottom - top);
+    if (ximage == NULL)
+	return;
+    Tree_XImage2PhotoAt(tree->interp, photoH, ximage,
+	    0, top - region[1], 255);
+    Tree_XDestroyImage(tree->display, ximage);
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * TreeDisplay_RenderCmd --
+ *
+ *	This procedure is invoked to process the [render] widget
+ *	command. The list is drawn offscreen and the pixels are put
+ *	into a photo image. Since nothing is read back from the
+ *	window, it need not be mapped or unobscured.
+ *
+ *	With -allrows the whole height of the canvas is rendered. It
+ *	is drawn one window-height band at a time by temporarily
+ *	changing the vertical scroll position, which keeps the
+ *	offscreen pixmap the size of the window.
+ *
+ * Results:
+ *	A standard Tcl result.
+ *
+ * Side effects:
+ *	The photo image is blanked and filled.
+ *
+ *--------------------------------------------------------------
+ */
+
+int
+TreeDisplay_RenderCmd(
+    TreeCtrl *tree,		/* Widget info. */
+    int objc,			/* Number of arguments. */
+    Tcl_Obj *CONST objv[]	/* Argument values. */
+    )
+{
+    Tcl_Interp *interp = tree->interp;
+    TreeDInfo dInfo = tree->dInfo;
+    Tk_Window tkwin = tree->tkwin;
+    static CONST char *optionNames[] = {
+	"-allrows", "-region", (char *) NULL
+    };
+    enum { OPT_ALLROWS, OPT_REGION };
+    int allRows = FALSE, regionSet = FALSE;
+    int region[4], i, index, listObjc;
+    Tcl_Obj **listObjv;
+    char *imageName;
+    Tk_PhotoHandle photoH;
+    TreeDrawable td;
+    int width, height, contentTop, contentBottom, visHeight;
+    int totalHeight, yOrigin, band, bandCount, top, bottom;
+
+    if (objc < 3) {
+	Tcl_WrongNumArgs(interp, 2, objv,
+		"?-allrows? ?-region {x1 y1 x2 y2}? photo");
+	return TCL_ERROR;
+    }
+
+    for (i = 2; i < objc - 1; i++) {
+	if (Tcl_GetIndexFromObj(interp, objv[i], optionNames, "option", 0,
+		&index) != TCL_OK) {
+	    return TCL_ERROR;
+	}
+	switch (index) {
+	    case OPT_ALLROWS:
+		allRows = TRUE;
+		break;
+	    case OPT_REGION:
+		if (i + 1 == objc - 1) {
+		    FormatResult(interp, "missing value for \"%s\" option",
+			    optionNames[index]);
+		    return TCL_ERROR;
+		}
+		i++;
+		if (Tcl_ListObjGetElements(interp, objv[i], &listObjc,
+			&listObjv) != TCL_OK)
+		    return TCL_ERROR;
+		if (listObjc != 4) {
+		    FormatResult(interp,
+			    "bad region \"%s\": must be {x1 y1 x2 y2}",
+			    Tcl_GetString(objv[i]));
+		    return TCL_ERROR;
+		}
+		for (index = 0; index < 4; index++) {
+		    if (Tk_GetPixelsFromObj(interp, tkwin, listObjv[index],
+			    &region[index]) != TCL_OK)
+			return TCL_ERROR;
+		}
+		regionSet = TRUE;
+		break;
+	}
+    }
+
+    imageName = Tcl_GetString(objv[objc - 1]);
+    photoH = Tk_FindPhoto(interp, imageName);
+    if (photoH == NULL) {
+	Tcl_AppendResult(interp, "image \"", imageName,
+		"\" doesn't exist or is not a photo image",
+		(char *) NULL);
+	return TCL_ERROR;
+    }
+
+    Tk_MakeWindowExist(tkwin);
+
+    /* Update columnCountVisXXX and the Ranges if needed. */
+    (void) Tree_WidthOfColumns(tree);
+    Range_RedoIfNeeded(tree);
+
+    /* Same as Tree_UpdateDInfo */
+    dInfo->empty = !Tree_AreaBbox(tree, TREE_AREA_CONTENT,
+	&dInfo->bounds[0], &dInfo->bounds[1],
+	&dInfo->bounds[2], &dInfo->bounds[3]);
+    dInfo->emptyL = !Tree_AreaBbox(tree, TREE_AREA_LEFT,
+	&dInfo->boundsL[0], &dInfo->boundsL[1],
+	&dInfo->boundsL[2], &dInfo->boundsL[3]);
+    dInfo->emptyR = !Tree_AreaBbox(tree, TREE_AREA_RIGHT,
+	&dInfo->boundsR[0], &dInfo->boundsR[1],
+	&dInfo->boundsR[2], &dInfo->boundsR[3]);
+
+    width = Tk_Width(tkwin);
+    height = Tk_Height(tkwin);
+    contentTop = Tree_ContentTop(tree);
+    contentBottom = Tree_ContentBottom(tree);
+    visHeight = contentBottom - contentTop;
+    totalHeight = visHeight;
+
+    if (allRows) {
+	if (visHeight <= 0) {
+	    FormatResult(interp, "can't render -allrows: no room for items");
+	    return TCL_ERROR;
+	}
+	totalHeight = MAX(Tree_TotalHeight(tree), visHeight);
+	height = contentTop + totalHeight + (height - contentBottom);
+    }
+
+    if (!regionSet) {
+	region[0] = region[1] = 0;
+	region[2] = width;
+	region[3] = height;
+    }
+    region[0] = MAX(region[0], 0);
+    region[1] = MAX(region[1], 0);
+    region[2] = MIN(region[2], width);
+    region[3] = MIN(region[3], height);
+
+    Tk_PhotoBlank(photoH);
+    if ((region[0] >= region[2]) || (region[1] >= region[3]))
+	return TCL_OK;
+
+    td.width = Tk_Width(tkwin);
+    td.height = Tk_Height(tkwin);
+    td.drawable = Tk_GetPixmap(tree->display, Tk_WindowId(tkwin),
+	    td.width, td.height, Tk_Depth(tkwin));
+
+    /* Window elements are left alone while rendering. */
+    tree->drawableOffscreen = TRUE;
+
+    if (!allRows) {
+	RenderView(tree, td);
+	RenderCopy(tree, photoH, td, 0, td.height, 0, region);
+	tree->drawableOffscreen = FALSE;
+	Tk_FreePixmap(tree->display, td.drawable);
+	return TCL_OK;
+    }
+
+    yOrigin = tree->yOrigin;
+    bandCount = (totalHeight + visHeight - 1) / visHeight;
+    for (band = 0; band < bandCount; band++) {
+	int offset = band * visHeight; /* Canvas */
+	int rows = MIN(visHeight, totalHeight - offset);
+
+	/* Skip bands that aren't in the region. The first band
+	 * supplies the header and the last band the bottom border. */
+	top = (band == 0) ? 0 : contentTop + offset;
+	bottom = (band == bandCount - 1) ? height : contentTop + offset + rows;
+	if ((bottom <= region[1]) || (top >= region[3]))
+	    continue;
+
+	/* Scroll the band to the top of the content area. */
+	tree->yOrigin = offset - contentTop;
+	RenderView(tree, td);
+
+	if (band == 0)
+	    RenderCopy(tree, photoH, td, 0, contentTop, 0, region);
+	RenderCopy(tree, photoH, td, contentTop, contentTop + rows,
+		contentTop + offset, region);
+	if (band == bandCount - 1)
+	    RenderCopy(tree, photoH, td, contentBottom, td.height,
+		    contentTop + totalHeight, region);
+    }
+    tree->yOrigin = yOrigin;
+    tree->drawableOffscreen = FALSE;
+
+    Tk_FreePixmap(tree->display, td.drawable);
+    return TCL_OK;
+}
+
 /*
  *--------------------------------------------------------------
  *
@@ -6137,6 +7461,8 @@ Increment_ToOffsetY(
     )
 {
     TreeDInfo dInfo = tree->dInfo;
+    IncrementRun *run;
+    int i, l, u;
 
     if (tree->yScrollIncrement <= 0) {
 	if (index < 0 || index >= dInfo->yScrollIncrementCount) {
@@ -6144,7 +7470,23 @@ Increment_ToOffsetY(
 		    index, dInfo->yScrollIncrementCount - 1,
 		    Tree_TotalHeight(tree), Tree_ContentHeight(tree));
 	}
-	return dInfo->yScrollIncrements[index];
+
+	/* Binary search for the run containing the index */
+	l = 0;
+	u = dInfo->yIncrementRunCount - 1;
+	while (1) {
+	    i = (l + u) / 2;
+	    run = &dInfo->yIncrementRuns[i];
+	    if (index < run->index)
+		u = i - 1;
+	    else if (index >= run->index + run->count)
+		l = i + 1;
+	    else
+		break;
+	}
+	if (run->step == 0)
+	    return dInfo->yScrollIncrements[run->first + index - run->index];
+	return run->offset + (index - run->index) * run->step;
     }
     return index * tree->yScrollIncrement;
 }
@@ -6391,6 +7733,10 @@ Tree_SetOriginX(
     tree->xOrigin = xOrigin;
     dInfo->incrementLeft = index;
 
+    /* Item heights depend on which columns are onscreen. */
+    if (tree->heightFromVisibleColumns)
+	Tree_DInfoChanged(tree, DINFO_REDO_RANGES);
+
     Tree_EventuallyRedraw(tree);
 }
 
@@ -6554,6 +7900,9 @@ Tree_RelayoutWindow(
     /* Needed if -background color changes. */
     dInfo->flags |= DINFO_DRAW_WHITESPACE;
 
+    /* -background, -backgroundimage or the window size may have changed. */
+    Tree_InvalidateBackgroundImage(tree);
+
     if (tree->doubleBuffer != DOUBLEBUFFER_WINDOW) {
 	if (dInfo->pixmapW.drawable != None) {
 	    Tk_FreePixmap(tree->display, dInfo->pixmapW.drawable);
@@ -6565,6 +7914,14 @@ Tree_RelayoutWindow(
 	    Tk_FreePixmap(tree->display, dInfo->pixmapI.drawable);
 	    dInfo->pixmapI.drawable = None;
 	}
+	if (dInfo->pixmapL.drawable != None) {
+	    Tk_FreePixmap(tree->display, dInfo->pixmapL.drawable);
+	    dInfo->pixmapL.drawable = None;
+	}
+	if (dInfo->pixmapR.drawable != None) {
+	    Tk_FreePixmap(tree->display, dInfo->pixmapR.drawable);
+	    dInfo->pixmapR.drawable = None;
+	}
     }
 
     if (tree->useTheme) {
@@ -6671,6 +8028,7 @@ Tree_Activate(
 
     /* Aqua column header looks different when window is not active */
     if (tree->useTheme && tree->showHeader) {
+	Tree_InvalidateColumnHeader(tree, NULL);
 	dInfo->flags |= DINFO_DRAW_HEADER;
 	Tree_EventuallyRedraw(tree);
     }
@@ -6723,6 +8081,101 @@ Tree_FreeItemDInfo(
     }
 }
 
+/*
+ *--------------------------------------------------------------
+ *
+ * DItem_AreaForColumn --
+ *
+ *	Return the DItemArea of a DItem that displays a column.
+ *
+ * Results:
+ *	Pointer to dItem->area, dItem->left or dItem->right.
+ *
+ * Side effects:
+ *	None.
+ *
+ *--------------------------------------------------------------
+ */
+
+static DItemArea *
+DItem_AreaForColumn(
+    DItem *dItem,		/* Display info for an item. */
+    TreeColumn column		/* Column in the item. */
+    )
+{
+    switch (TreeColumn_Lock(column)) {
+	case COLUMN_LOCK_LEFT:
+	    return &dItem->left;
+	case COLUMN_LOCK_RIGHT:
+	    return &dItem->right;
+    }
+    return &dItem->area;
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * DItem_SpanWidth --
+ *
+ *	Calculate the width of the span starting at a column in an
+ *	onscreen item.
+ *
+ * Results:
+ *	The width of the span, or zero if the column is not the first
+ *	column of a span.
+ *
+ * Side effects:
+ *	None.
+ *
+ *--------------------------------------------------------------
+ */
+
+static int
+DItem_SpanWidth(
+    TreeCtrl *tree,		/* Widget info. */
+    DItem *dItem,		/* Display info for an item. */
+    DItemArea *area,		/* The area displaying the column. */
+    TreeColumn column		/* First column in the span. */
+    )
+{
+    TreeColumn column2;
+    int columnIndex, width, i;
+
+    columnIndex = TreeColumn_Index(column);
+
+    /* If only one column is visible, the width may be
+    * different than the column width. */
+    if ((TreeColumn_Lock(column) == COLUMN_LOCK_NONE) &&
+	    (tree->columnCountVis == 1)) {
+	return area->width;
+    }
+
+    /* All spans are 1. */
+    if (dItem->spans == NULL)
+	return TreeColumn_GetDInfo(column)->width;
+
+    /* If the column being redrawn is not the first in the span,
+     * then do nothing. */
+    if (columnIndex != dItem->spans[columnIndex])
+	return 0;
+
+    /* Calculate the width of the entire span. */
+    /* Do NOT call TreeColumn_UseWidth() or another routine
+    * that calls Tree_WidthOfColumns() because that may end
+    * up recalculating the size of items whose display info
+    * is currently being invalidated. */
+    width = 0;
+    column2 = column;
+    i = columnIndex;
+    while (dItem->spans[i] == columnIndex) {
+	width += TreeColumn_GetDInfo(column2)->width;
+	if (++i == tree->columnCount)
+	    break;
+	column2 = TreeColumn_Next(column2);
+    }
+    return width;
+}
+
 /*
  *--------------------------------------------------------------
  *
@@ -6751,17 +8204,21 @@ Tree_InvalidateItemDInfo(
     )
 {
     TreeDInfo dInfo = tree->dInfo;
-    TreeColumn column2;
     DItem *dItem;
     TreeItem item = item1;
     int changed = 0;
 
-    if (dInfo->flags & (DINFO_INVALIDATE | DINFO_REDO_COLUMN_WIDTH))
+    if (dInfo->flags & (DINFO_INVALIDATE | DINFO_REDO_COLUMN_WIDTH)) {
+	dInfo->hitStamp++;
 	return;
+    }
 
     while (item != NULL) {
 	dItem = (DItem *) TreeItem_GetDInfo(tree, item);
-	if ((dItem == NULL) || DItemAllDirty(tree, dItem))
+	if (dItem == NULL)
+	    goto next;
+	dItem->hits.style = NULL;
+	if (DItemAllDirty(tree, dItem))
 	    goto next;
 
 	if (column == NULL) {
@@ -6771,63 +8228,19 @@ Tree_InvalidateItemDInfo(
 	    changed = 1;
 	} else {
 	    TreeColumnDInfo dColumn = TreeColumn_GetDInfo(column);
-	    int columnIndex, left, width, i;
-	    DItemArea *area = NULL;
-
-	    switch (TreeColumn_Lock(column)) {
-		case COLUMN_LOCK_NONE:
-		    area = &dItem->area;
-		    break;
-		case COLUMN_LOCK_LEFT:
-		    area = &dItem->left;
-		    break;
-		case COLUMN_LOCK_RIGHT:
-		    area = &dItem->right;
-		    break;
-	    }
+	    int left, width;
+	    DItemArea *area = DItem_AreaForColumn(dItem, column);
 
 	    if (area->flags & DITEM_ALL_DIRTY)
 		goto next;
 
-	    columnIndex = TreeColumn_Index(column);
 	    left = dColumn->offset;
-
-	    /* If only one column is visible, the width may be
-	    * different than the column width. */
-	    if ((TreeColumn_Lock(column) == COLUMN_LOCK_NONE) &&
-		    (tree->columnCountVis == 1)) {
-		width = area->width;
-
-	    /* All spans are 1. */
-	    } else if (dItem->spans == NULL) {
-		width = dColumn->width;
-
-	    /* If the column being redrawn is not the first in the span,
-	     * then do nothing. */
-	    } else if (columnIndex != dItem->spans[columnIndex]) {
-		goto next;
-
-	    /* Calculate the width of the entire span. */
-	    /* Do NOT call TreeColumn_UseWidth() or another routine
-	    * that calls Tree_WidthOfColumns() because that may end
-	    * up recalculating the size of items whose display info
-	    * is currently being invalidated. */
-	    } else {
-		width = 0;
-		column2 = column;
-		i = columnIndex;
-		while (dItem->spans[i] == columnIndex) {
-		    width += TreeColumn_GetDInfo(column2)->width;
-		    if (++i == tree->columnCount)
-			break;
-		    column2 = TreeColumn_Next(column2);
-		}
-	    }
+	    width = DItem_SpanWidth(tree, dItem, area, column);
 
 	    if (width > 0) {
 		InvalidateDItemX(dItem, area, 0, left, width);
 		InvalidateDItemY(dItem, area, 0, 0, dItem->height);
-		area->flags |= DITEM_DIRTY;
+		area->flags |= DITEM_DIRTY | DITEM_CACHE_DIRTY;
 		changed = 1;
 	    }
 	}
@@ -6841,6 +8254,113 @@ next:
     }
 }
 
+/*
+ *--------------------------------------------------------------
+ *
+ * Tree_InvalidateItemDInfoRect --
+ *
+ *	Mark as dirty part of an item-column's span in an onscreen
+ *	item. This is called when the appearance of a single element
+ *	changed so the rest of the span needn't be redrawn.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	The widget will be redisplayed at idle time if the item has a
+ *	DItem.
+ *
+ *--------------------------------------------------------------
+ */
+
+void
+Tree_InvalidateItemDInfoRect(
+    TreeCtrl *tree,		/* Widget info. */
+    TreeColumn column,		/* First column of the span. */
+    TreeItem item,		/* Item to invalidate. */
+    int x, int y,		/* Top-left of the area relative to the
+				 * top-left of the span. */
+    int width, int height	/* Size of the area. */
+    )
+{
+    TreeDInfo dInfo = tree->dInfo;
+    TreeColumnDInfo dColumn = TreeColumn_GetDInfo(column);
+    DItem *dItem;
+    DItemArea *area;
+    int spanWidth;
+
+    if (dInfo->flags & (DINFO_INVALIDATE | DINFO_REDO_COLUMN_WIDTH))
+	return;
+
+    dItem = (DItem *) TreeItem_GetDInfo(tree, item);
+    if ((dItem == NULL) || DItemAllDirty(tree, dItem))
+	return;
+
+    area = DItem_AreaForColumn(dItem, column);
+    if (area->flags & DITEM_ALL_DIRTY)
+	return;
+
+    /* Clip to the span and the item. */
+    spanWidth = DItem_SpanWidth(tree, dItem, area, column);
+    if (x < 0) {
+	width += x;
+	x = 0;
+    }
+    if (x + width > spanWidth)
+	width = spanWidth - x;
+    if (y < 0) {
+	height += y;
+	y = 0;
+    }
+    if (y + height > dItem->height)
+	height = dItem->height - y;
+    if ((width <= 0) || (height <= 0))
+	return;
+
+    InvalidateDItemX(dItem, area, 0, dColumn->offset + x, width);
+    InvalidateDItemY(dItem, area, 0, y, height);
+    area->flags |= DITEM_DIRTY | DITEM_CACHE_DIRTY;
+    Tree_EventuallyRedraw(tree);
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * TreeDisplay_ItemHitCache --
+ *
+ *	Return the StyleHitCache of an item's DItem for use by
+ *	TreeStyle_Identify.
+ *
+ * Results:
+ *	Pointer to the cache, or NULL if the item isn't onscreen.
+ *	The cache is emptied if anything was invalidated since it
+ *	was filled.
+ *
+ * Side effects:
+ *	None.
+ *
+ *--------------------------------------------------------------
+ */
+
+StyleHitCache *
+TreeDisplay_ItemHitCache(
+    TreeCtrl *tree,		/* Widget info. */
+    TreeItem item		/* Item token. */
+    )
+{
+    TreeDInfo dInfo = tree->dInfo;
+    DItem *dItem;
+
+    dItem = (DItem *) TreeItem_GetDInfo(tree, item);
+    if (dItem == NULL)
+	return NULL;
+    if (dItem->hitStamp != dInfo->hitStamp) {
+	dItem->hits.style = NULL;
+	dItem->hitStamp = dInfo->hitStamp;
+    }
+    return &dItem->hits;
+}
+
 /*
  *--------------------------------------------------------------
  *
@@ -6981,6 +8501,7 @@ Tree_DInfoChanged(
     TreeDInfo dInfo = tree->dInfo;
 
     dInfo->flags |= flags;
+    dInfo->hitStamp++;
     Tree_EventuallyRedraw(tree);
 }
 
@@ -7068,6 +8589,7 @@ Tree_InvalidateArea(
 	TkUnionRectWithRegion(&rect, rgn, rgn);
 	TkSubtractRegion(dInfo->wsRgn, rgn, dInfo->wsRgn);
 	Tree_FreeRegion(tree, rgn);
+	dInfo->wsRgnCurrent = FALSE;
     }
 
     if (tree->debug.enable && tree->debug.display && tree->debug.eraseColor) {
@@ -7183,6 +8705,7 @@ Tree_InvalidateRegion(
 
     /* Invalidate part of the whitespace */
     TkSubtractRegion(dInfo->wsRgn, region, dInfo->wsRgn);
+    dInfo->wsRgnCurrent = FALSE;
 
     Tree_FreeRegion(tree, rgn);
 
@@ -7348,8 +8871,11 @@ TreeDInfo_Init(
     dInfo->scrollGC = Tk_GetGC(tree->tkwin, GCGraphicsExposures, &gcValues);
     dInfo->flags = DINFO_OUT_OF_DATE;
     dInfo->wsRgn = Tree_GetRegion(tree);
+    dInfo->wsRgnCalc = TkCreateRegion();
     dInfo->dirtyRgn = TkCreateRegion();
     Tcl_InitHashTable(&dInfo->itemVisHash, TCL_ONE_WORD_KEYS);
+    TreePtrList_Init(tree, &dInfo->dItemNew, 0);
+    TreeItemList_Init(tree, &dInfo->itemGone, 0);
     tree->dInfo = dInfo;
 }
 
@@ -7381,17 +8907,21 @@ TreeDInfo_Free(
 
     if (dInfo->rItem != NULL)
 	ckfree((char *) dInfo->rItem);
+    if (dInfo->rangeArray != NULL)
+	ckfree((char *) dInfo->rangeArray);
     if (dInfo->rangeLock != NULL)
 	ckfree((char *) dInfo->rangeLock);
     while (dInfo->dItem != NULL) {
 	DItem *next = dInfo->dItem->next;
-	WFREE(dInfo->dItem, DItem);
+	if (dInfo->dItem->hits.rects != NULL)
+	    ckfree((char *) dInfo->dItem->hits.rects);
 	dInfo->dItem = next;
     }
-    while (dInfo->dItemFree != NULL) {
-	DItem *next = dInfo->dItemFree->next;
-	WFREE(dInfo->dItemFree, DItem);
-	dInfo->dItemFree = next;
+    while (dInfo->dItemSlabs != NULL) {
+	DItemSlab *next = dInfo->dItemSlabs->next;
+	WIPEFREE(dInfo->dItemSlabs, Tk_Offset(DItemSlab, dItems) +
+	    dInfo->dItemSlabs->count * sizeof(DItem));
+	dInfo->dItemSlabs = next;
     }
     while (range != NULL)
 	range = Range_Free(tree, range);
@@ -7402,11 +8932,24 @@ TreeDInfo_Free(
 	Tk_FreePixmap(tree->display, dInfo->pixmapW.drawable);
     if (dInfo->pixmapI.drawable != None)
 	Tk_FreePixmap(tree->display, dInfo->pixmapI.drawable);
+    if (dInfo->pixmapL.drawable != None)
+	Tk_FreePixmap(tree->display, dInfo->pixmapL.drawable);
+    if (dInfo->pixmapR.drawable != None)
+	Tk_FreePixmap(tree->display, dInfo->pixmapR.drawable);
+    if (dInfo->pixmapBg.drawable != None)
+	Tk_FreePixmap(tree->display, dInfo->pixmapBg.drawable);
     if (dInfo->xScrollIncrements != NULL)
 	ckfree((char *) dInfo->xScrollIncrements);
     if (dInfo->yScrollIncrements != NULL)
 	ckfree((char *) dInfo->yScrollIncrements);
+    if (dInfo->yIncrementRuns != NULL)
+	ckfree((char *) dInfo->yIncrementRuns);
     Tree_FreeRegion(tree, dInfo->wsRgn);
+    TkDestroyRegion(dInfo->wsRgnCalc);
+    if (dInfo->wsRects != NULL) {
+	ckfree((char *) dInfo->wsRects);
+	ckfree((char *) dInfo->wsRectsNew);
+    }
     TkDestroyRegion(dInfo->dirtyRgn);
 #ifdef DCOLUMN
     hPtr = Tcl_FirstHashEntry(&dInfo->itemVisHash, &search);
@@ -7416,6 +8959,12 @@ TreeDInfo_Free(
     }
 #endif
     Tcl_DeleteHashTable(&dInfo->itemVisHash);
+    TreePtrList_Free(&dInfo->dItemNew);
+    TreeItemList_Free(&dInfo->itemGone);
+    if (dInfo->columnArray != NULL)
+	ckfree((char *) dInfo->columnArray);
+    if (dInfo->columnBits != NULL)
+	ckfree((char *) dInfo->columnBits);
     WFREE(dInfo, TreeDInfo_);
 }
 
@@ -7453,13 +9002,11 @@ Tree_DumpDInfo(
 
     if (index == DUMP_ALLOC) {
 	int count = 0, size = 0;
-	for (dItem = dInfo->dItem; dItem != NULL; dItem = dItem->next) {
-	    count += 1;
-	}
-	for (dItem = dInfo->dItemFree; dItem != NULL; dItem = dItem->next) {
-	    count += 1;
+	DItemSlab *slab;
+	for (slab = dInfo->dItemSlabs; slab != NULL; slab = slab->next) {
+	    count += slab->count;
+	    size += Tk_Offset(DItemSlab, dItems) + slab->count * sizeof(DItem);
 	}
-	size = count * sizeof(DItem);
 	DStringAppendf(&dString, "%-20s: %8d : %8d B %5d KB\n",
 		"DItem", count, size, (size + 1023) / 1024);
 
@@ -11,6 +11,8 @@
 #include "tkTreeCtrl.h"
 #include "tkTreeElem.h"
 
+#include <time.h>
+
 /*
  *----------------------------------------------------------------------
  *
@@ -2384,6 +2386,12 @@ typedef struct ElementTextLayout2 {
     int layoutWidth;
     int neededWidth;
     int totalWidth;
+    int fitWidth;		/* Display width, font and text the last */
+    Tk_Font fitFont;		/* Tree_Ellipsis() result was found for. */
+    char *fitText;		/* fitWidth is -1 when out-of-date. */
+    int fitTextLen;
+    int fitBytes;		/* Tree_Ellipsis() result. */
+    int fitPixels;
 } ElementTextLayout2;
 
 #define TEXT_STYLE
@@ -2411,6 +2419,12 @@ typedef struct ElementTextVar {
     TreeCtrl *tree;			/* needed to redisplay */
     TreeItem item;			/* needed to redisplay */
     TreeItemColumn column;		/* needed to redisplay */
+    ElementText *elemX;			/* The element. */
+    struct TextVarTrace *trace;		/* Trace on the variable, or NULL. */
+    struct ElementTextVar *prevWatcher;	/* Previous element with the same
+					 * -textvariable. */
+    struct ElementTextVar *nextWatcher;	/* Next element with the same
+					 * -textvariable. */
 } ElementTextVar;
 #endif
 
@@ -2521,6 +2535,561 @@ static int WorldChangedProcText(TreeElementArgs *args)
     return mask;
 }
 
+/*
+ * A TextFormat is a -format string compiled so that -data values can be
+ * formatted without calling the Tcl [format] or [clock format] commands.
+ * Only the common cases are handled here; everything else is passed on
+ * to Tcl by TextUpdateStringRep().
+ */
+
+#define TF_UNKNOWN -1		/* Not compiled yet. */
+#define TF_TCL 0		/* Must be formatted by Tcl. */
+#define TF_NATIVE 1		/* Handled by TextFormat_Number() or
+				 * TextFormat_Time(). */
+
+typedef struct TextFormat {
+    int numState;		/* TF_xxx for numbers and strings. */
+    char *prefix;		/* Text before the conversion. */
+    char *suffix;		/* Text after the conversion. */
+    char conv;			/* Conversion character. */
+    int isLong;			/* TRUE if the conversion had a 'l'
+				 * modifier. */
+    int group;			/* TRUE if digits are grouped in
+				 * thousands (the ' flag). */
+    int left;			/* TRUE if left-justified when grouping. */
+    int zero;			/* TRUE if padded with zeros when
+				 * grouping. */
+    int width;			/* Field width when grouping. */
+    char spec[24];		/* Conversion for sprintf(). */
+    Tcl_Obj *tclFormatObj;	/* -format without any ' flags, for the
+				 * Tcl [format] command. NULL if the
+				 * -format has no ' flags. */
+    int timeState;		/* TF_xxx for -datatype time. */
+    char *timeFormat;		/* -format with only the conversions
+				 * handled by TextFormat_Time(). */
+} TextFormat;
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TextFormat_CompileNumber --
+ *
+ *	Check whether a -format string for a number or string is one
+ *	that TextFormat_Number() can handle: any literal text and a
+ *	single %d, %i, %e, %f, %g, %E, %G or plain %s conversion with
+ *	optional flags, width, precision and 'l' modifier.
+ *
+ * Results:
+ *	TF_NATIVE or TF_TCL.
+ *
+ * Side effects:
+ *	Memory may be allocated.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+TextFormat_CompileNumber(
+    TextFormat *tf,		/* Format to compile. */
+    CONST char *format		/* The -format string. */
+    )
+{
+    Tcl_DString prefix, *dsPtr = &prefix;
+    Tcl_DString suffix;
+    CONST char *p = format;
+    char flags[8];
+    int numFlags = 0, width = -1, precision = -1, seen = FALSE;
+    int result = TF_TCL;
+
+    Tcl_DStringInit(&prefix);
+    Tcl_DStringInit(&suffix);
+
+    while (*p != '\0') {
+	if (*p != '%') {
+	    Tcl_DStringAppend(dsPtr, p++, 1);
+	    continue;
+	}
+	p++;
+	if (*p == '%') {
+	    Tcl_DStringAppend(dsPtr, p++, 1);
+	    continue;
+	}
+
+	/* Only one conversion is allowed since there is only one value. */
+	if (seen)
+	    goto done;
+	seen = TRUE;
+
+	while ((*p != '\0') && (strchr("-+ 0#'", *p) != NULL)) {
+	    if (*p == '\'')
+		tf->group = TRUE;
+	    else if (numFlags < (int) sizeof(flags) - 1)
+		flags[numFlags++] = *p;
+	    if (*p == '-')
+		tf->left = TRUE;
+	    p++;
+	}
+	flags[numFlags] = '\0';
+	if (isdigit(UCHAR(*p))) {
+	    width = 0;
+	    while (isdigit(UCHAR(*p)) && (width < 100))
+		width = width * 10 + (*p++ - '0');
+	}
+	if (*p == '.') {
+	    p++;
+	    precision = 0;
+	    while (isdigit(UCHAR(*p)) && (precision < 100))
+		precision = precision * 10 + (*p++ - '0');
+	}
+
+	/* Positional (XPG) arguments, '*' and huge numbers go to Tcl. */
+	if ((width >= 100) || (precision >= 100) || (*p == '$') ||
+		(*p == '*'))
+	    goto done;
+	if (*p == 'l') {
+	    tf->isLong = TRUE;
+	    p++;
+	}
+	tf->conv = *p;
+	switch (*p) {
+	    case 'd': case 'i':
+		if (strchr(flags, '#') != NULL || precision != -1)
+		    goto done;
+		break;
+	    case 'e': case 'f': case 'g': case 'E': case 'G':
+		if (tf->isLong)
+		    goto done;
+		if (tf->group && (*p != 'f'))
+		    goto done;
+		break;
+	    case 's':
+		if (numFlags || tf->group || tf->isLong || (width != -1) ||
+			(precision != -1))
+		    goto done;
+		break;
+	    default:
+		goto done;
+	}
+	p++;
+
+	if (tf->group) {
+	    tf->width = width;
+	    tf->zero = !tf->left && (strchr(flags, '0') != NULL);
+	    width = -1;
+	}
+	strcpy(tf->spec, "%");
+	strcat(tf->spec, flags);
+	if (width != -1)
+	    sprintf(tf->spec + strlen(tf->spec), "%d", width);
+	if (precision != -1)
+	    sprintf(tf->spec + strlen(tf->spec), ".%d", precision);
+	if ((tf->conv == 'd') || (tf->conv == 'i'))
+	    strcat(tf->spec, TCL_LL_MODIFIER);
+	sprintf(tf->spec + strlen(tf->spec), "%c", tf->conv);
+
+	dsPtr = &suffix;
+    }
+    if (!seen)
+	goto done;
+
+    tf->prefix = ckalloc(Tcl_DStringLength(&prefix) + 1);
+    strcpy(tf->prefix, Tcl_DStringValue(&prefix));
+    tf->suffix = ckalloc(Tcl_DStringLength(&suffix) + 1);
+    strcpy(tf->suffix, Tcl_DStringValue(&suffix));
+    result = TF_NATIVE;
+
+done:
+    Tcl_DStringFree(&prefix);
+    Tcl_DStringFree(&suffix);
+    return result;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TextFormat_Number --
+ *
+ *	Format a -data value with a compiled -format string. The
+ *	result is the same as the Tcl [format] command would give.
+ *
+ * Results:
+ *	TCL_OK if the value was formatted, TCL_ERROR if it must be
+ *	formatted by Tcl.
+ *
+ * Side effects:
+ *	The result is appended to the dynamic string.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+TextFormat_Number(
+    TextFormat *tf,		/* Compiled -format. */
+    Tcl_Obj *dataObj,		/* -data value. */
+    Tcl_DString *dsPtr		/* Initialized dynamic string. */
+    )
+{
+    char buf[1024], *p, *digits;
+    Tcl_WideInt w;
+    double d;
+    int i, length, numDigits, zero;
+
+    switch (tf->conv) {
+	case 'd': case 'i':
+	    /* Bignums are left to Tcl. */
+	    if (Tcl_GetWideIntFromObj(NULL, dataObj, &w) != TCL_OK)
+		return TCL_ERROR;
+	    /* [format] truncates %d to a long and %ld to a wide. */
+	    if (!tf->isLong)
+		w = (long) w;
+	    sprintf(buf, tf->spec, w);
+	    break;
+	case 's':
+	    Tcl_DStringAppend(dsPtr, tf->prefix, -1);
+	    Tcl_DStringAppend(dsPtr, Tcl_GetString(dataObj), -1);
+	    Tcl_DStringAppend(dsPtr, tf->suffix, -1);
+	    return TCL_OK;
+	default:
+	    if (Tcl_GetDoubleFromObj(NULL, dataObj, &d) != TCL_OK)
+		return TCL_ERROR;
+	    /* [format] rejects NaN, leave the error to Tcl. */
+	    if (d != d)
+		return TCL_ERROR;
+	    sprintf(buf, tf->spec, d);
+	    break;
+    }
+
+    Tcl_DStringAppend(dsPtr, tf->prefix, -1);
+    if (!tf->group) {
+	Tcl_DStringAppend(dsPtr, buf, -1);
+	Tcl_DStringAppend(dsPtr, tf->suffix, -1);
+	return TCL_OK;
+    }
+
+    /* Insert a comma between each group of 3 digits in the integer part. */
+    for (digits = buf; *digits != '\0' && !isdigit(UCHAR(*digits)); digits++)
+	;
+    for (numDigits = 0; isdigit(UCHAR(digits[numDigits])); numDigits++)
+	;
+    length = strlen(buf) + (numDigits - 1) / 3;
+    zero = tf->zero && (numDigits > 0);
+    if (!tf->left && !zero) {
+	for (i = length; i < tf->width; i++)
+	    Tcl_DStringAppend(dsPtr, " ", 1);
+    }
+    Tcl_DStringAppend(dsPtr, buf, digits - buf);
+    /* Zeros go between the sign and the digits and are not grouped. */
+    if (zero) {
+	for (i = length; i < tf->width; i++)
+	    Tcl_DStringAppend(dsPtr, "0", 1);
+    }
+    for (p = digits, i = numDigits; i > 0; i--) {
+	Tcl_DStringAppend(dsPtr, p++, 1);
+	if ((i > 1) && ((i - 1) % 3 == 0))
+	    Tcl_DStringAppend(dsPtr, ",", 1);
+    }
+    Tcl_DStringAppend(dsPtr, p, -1);
+    if (tf->left) {
+	for (i = length; i < tf->width; i++)
+	    Tcl_DStringAppend(dsPtr, " ", 1);
+    }
+    Tcl_DStringAppend(dsPtr, tf->suffix, -1);
+    return TCL_OK;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TextFormat_CompileTime --
+ *
+ *	Check whether a -format string for -datatype time uses only
+ *	the numeric [clock format] conversions that TextFormat_Time()
+ *	can handle. %D, %R and %T are expanded.
+ *
+ * Results:
+ *	TF_NATIVE or TF_TCL.
+ *
+ * Side effects:
+ *	Memory may be allocated.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+TextFormat_CompileTime(
+    TextFormat *tf,		/* Format to compile. */
+    CONST char *format		/* The -format string. */
+    )
+{
+    Tcl_DString dString;
+    CONST char *p;
+
+    Tcl_DStringInit(&dString);
+    for (p = format; *p != '\0'; p++) {
+	if (*p != '%') {
+	    Tcl_DStringAppend(&dString, p, 1);
+	    continue;
+	}
+	switch (*++p) {
+	    case 'd': case 'e': case 'H': case 'I': case 'j': case 'k':
+	    case 'l': case 'm': case 'M': case 'S': case 'y': case 'Y':
+	    case '%':
+		Tcl_DStringAppend(&dString, p - 1, 2);
+		break;
+	    case 'D':
+		Tcl_DStringAppend(&dString, "%m/%d/%Y", -1);
+		break;
+	    case 'R':
+		Tcl_DStringAppend(&dString, "%H:%M", -1);
+		break;
+	    case 'T':
+		Tcl_DStringAppend(&dString, "%H:%M:%S", -1);
+		break;
+	    default:
+		Tcl_DStringFree(&dString);
+		return TF_TCL;
+	}
+    }
+    tf->timeFormat = ckalloc(Tcl_DStringLength(&dString) + 1);
+    strcpy(tf->timeFormat, Tcl_DStringValue(&dString));
+    Tcl_DStringFree(&dString);
+    return TF_NATIVE;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TextFormat_Time --
+ *
+ *	Format a -data value in clock seconds with a compiled -format
+ *	string. The result is the same as [clock format] would give in
+ *	the local timezone.
+ *
+ * Results:
+ *	TCL_OK if the value was formatted, TCL_ERROR if it must be
+ *	formatted by Tcl.
+ *
+ * Side effects:
+ *	The result is appended to the dynamic string.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+TextFormat_Time(
+    TextFormat *tf,		/* Compiled -format. */
+    Tcl_Obj *dataObj,		/* -data value. */
+    Tcl_DString *dsPtr		/* Initialized dynamic string. */
+    )
+{
+    Tcl_WideInt w;
+    time_t t;
+    struct tm tm;
+    CONST char *p, *start;
+    char buf[16];
+    int year, hour12;
+
+    /* Tcl has its own idea of the timezone if TCL_TZ is set. */
+    if (getenv("TCL_TZ") != NULL)
+	return TCL_ERROR;
+
+    if (Tcl_GetWideIntFromObj(NULL, dataObj, &w) != TCL_OK)
+	return TCL_ERROR;
+    t = (time_t) w;
+    if ((Tcl_WideInt) t != w)
+	return TCL_ERROR;
+
+#ifdef WIN32
+    /* The Microsoft C runtime keeps the localtime() result per-thread. */
+    {
+	struct tm *tmPtr = localtime(&t);
+	if (tmPtr == NULL)
+	    return TCL_ERROR;
+	tm = *tmPtr;
+    }
+#else
+    if (localtime_r(&t, &tm) == NULL)
+	return TCL_ERROR;
+#endif
+
+    year = tm.tm_year + 1900;
+    if ((year < 1000) || (year > 9999))
+	return TCL_ERROR;
+    hour12 = (tm.tm_hour % 12) ? (tm.tm_hour % 12) : 12;
+
+    for (p = tf->timeFormat; *p != '\0'; p++) {
+	if (*p != '%') {
+	    for (start = p; p[1] != '\0' && p[1] != '%'; p++)
+		;
+	    Tcl_DStringAppend(dsPtr, start, p - start + 1);
+	    continue;
+	}
+	switch (*++p) {
+	    case 'd': sprintf(buf, "%02d", tm.tm_mday); break;
+	    case 'e': sprintf(buf, "%2d", tm.tm_mday); break;
+	    case 'H': sprintf(buf, "%02d", tm.tm_hour); break;
+	    case 'I': sprintf(buf, "%02d", hour12); break;
+	    case 'j': sprintf(buf, "%03d", tm.tm_yday + 1); break;
+	    case 'k': sprintf(buf, "%2d", tm.tm_hour); break;
+	    case 'l': sprintf(buf, "%2d", hour12); break;
+	    case 'm': sprintf(buf, "%02d", tm.tm_mon + 1); break;
+	    case 'M': sprintf(buf, "%02d", tm.tm_min); break;
+	    case 'S': sprintf(buf, "%02d", tm.tm_sec); break;
+	    case 'y': sprintf(buf, "%02d", year % 100); break;
+	    case 'Y': sprintf(buf, "%04d", year); break;
+	    default: strcpy(buf, "%"); break;
+	}
+	Tcl_DStringAppend(dsPtr, buf, -1);
+    }
+    return TCL_OK;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TextFormat_StripGroup --
+ *
+ *	Remove the ' flag from every conversion in a -format string
+ *	for numbers, since the Tcl [format] command rejects it. Used
+ *	when a value must be formatted by Tcl.
+ *
+ * Results:
+ *	A new Tcl_Obj with a reference count of 1, or NULL if the
+ *	-format has no ' flags.
+ *
+ * Side effects:
+ *	Memory may be allocated.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static Tcl_Obj *
+TextFormat_StripGroup(
+    CONST char *format		/* The -format string. */
+    )
+{
+    Tcl_Obj *objPtr;
+    CONST char *p = format, *start;
+    int stripped = FALSE;
+
+    objPtr = Tcl_NewObj();
+    while (*p != '\0') {
+	if (*p != '%') {
+	    Tcl_AppendToObj(objPtr, p++, 1);
+	    continue;
+	}
+	Tcl_AppendToObj(objPtr, p++, 1);
+	if (*p == '%') {
+	    Tcl_AppendToObj(objPtr, p++, 1);
+	    continue;
+	}
+
+	/* Skip an XPG position such as "1$" before the flags. */
+	for (start = p; isdigit(UCHAR(*p)); p++)
+	    ;
+	if (*p == '$')
+	    p++;
+	else
+	    p = start;
+	Tcl_AppendToObj(objPtr, start, p - start);
+
+	while ((*p != '\0') && (strchr("-+ 0#'", *p) != NULL)) {
+	    if (*p == '\'')
+		stripped = TRUE;
+	    else
+		Tcl_AppendToObj(objPtr, p, 1);
+	    p++;
+	}
+    }
+    if (!stripped) {
+	Tcl_DecrRefCount(objPtr);
+	return NULL;
+    }
+    Tcl_IncrRefCount(objPtr);
+    return objPtr;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TextFormat_Data --
+ *
+ *	Format the -data value of a text element without calling Tcl,
+ *	if the -format string is simple enough. Compiled -format
+ *	strings are remembered per-widget.
+ *
+ * Results:
+ *	TCL_OK if the value was formatted, TCL_ERROR if it must be
+ *	formatted by Tcl. In the latter case *formatObjPtr may be
+ *	changed to a -format without ' flags that Tcl accepts.
+ *
+ * Side effects:
+ *	The result is appended to the dynamic string. Memory may be
+ *	allocated.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+TextFormat_Data(
+    TreeCtrl *tree,		/* Widget info. */
+    int dataType,		/* TDT_xxx */
+    Tcl_Obj *dataObj,		/* -data value. */
+    Tcl_Obj **formatObjPtr,	/* In: -format value, or NULL.
+				 * Out: -format value for Tcl. */
+    Tcl_DString *dsPtr		/* Initialized dynamic string. */
+    )
+{
+    Tcl_HashEntry *hPtr;
+    TextFormat *tf;
+    CONST char *format;
+    int isNew;
+
+    if (*formatObjPtr != NULL)
+	format = Tcl_GetString(*formatObjPtr);
+    else switch (dataType) {
+	case TDT_DOUBLE: format = "%g"; break;
+	case TDT_INTEGER: format = "%d"; break;
+	case TDT_LONG: format = "%ld"; break;
+	case TDT_STRING: format = "%s"; break;
+	default: return TCL_ERROR; /* default [clock format] */
+    }
+
+    if (tree->textFormatHash == NULL) {
+	tree->textFormatHash = (Tcl_HashTable *) ckalloc(sizeof(Tcl_HashTable));
+	Tcl_InitHashTable(tree->textFormatHash, TCL_STRING_KEYS);
+    }
+    hPtr = Tcl_CreateHashEntry(tree->textFormatHash, format, &isNew);
+    if (isNew) {
+	tf = (TextFormat *) ckalloc(sizeof(TextFormat));
+	memset(tf, '\0', sizeof(TextFormat));
+	tf->numState = TF_UNKNOWN;
+	tf->timeState = TF_UNKNOWN;
+	Tcl_SetHashValue(hPtr, (ClientData) tf);
+    } else {
+	tf = (TextFormat *) Tcl_GetHashValue(hPtr);
+    }
+
+    if (dataType == TDT_TIME) {
+	if (tf->timeState == TF_UNKNOWN)
+	    tf->timeState = TextFormat_CompileTime(tf, format);
+	if (tf->timeState == TF_TCL)
+	    return TCL_ERROR;
+	return TextFormat_Time(tf, dataObj, dsPtr);
+    }
+
+    if (tf->numState == TF_UNKNOWN) {
+	tf->numState = TextFormat_CompileNumber(tf, format);
+	tf->tclFormatObj = TextFormat_StripGroup(format);
+    }
+    if ((tf->numState == TF_NATIVE) &&
+	    (TextFormat_Number(tf, dataObj, dsPtr) == TCL_OK))
+	return TCL_OK;
+    if (tf->tclFormatObj != NULL)
+	*formatObjPtr = tf->tclFormatObj;
+    return TCL_ERROR;
+}
+
 static void TextUpdateStringRep(TreeElementArgs *args)
 {
     TreeCtrl *tree = args->tree;
@@ -2604,6 +3173,22 @@ static void TextUpdateStringRep(TreeElementArgs *args)
 	Tcl_ObjCmdProc *clockObjCmd = NULL, *formatObjCmd = NULL;
 	ClientData clockClientData = NULL, formatClientData = NULL;
 	Tcl_CmdInfo cmdInfo;
+	Tcl_DString dString;
+
+	/* Try the built-in formatter before calling Tcl. */
+	Tcl_DStringInit(&dString);
+	if (TextFormat_Data(tree, dataType, dataObj, &formatObj,
+		&dString) == TCL_OK) {
+	    elemX->textLen = Tcl_DStringLength(&dString);
+	    if (elemX->textLen > 0) {
+		elemX->text = ckalloc(elemX->textLen);
+		memcpy(elemX->text, Tcl_DStringValue(&dString),
+		    elemX->textLen);
+	    }
+	    Tcl_DStringFree(&dString);
+	    return;
+	}
+	Tcl_DStringFree(&dString);
 
 	if (staticFormat[0] == NULL) {
 	    staticFormat[0] = Tcl_NewStringObj("%g", -1);
@@ -2707,12 +3292,42 @@ static void TextUpdateStringRep(TreeElementArgs *args)
     }
 }
 
+/* Return the ElementTextLayout2 of a text element, allocating it if
+ * needed. Besides the TextLayout it holds where DisplayProcText() last
+ * put an ellipsis, so it is allocated when the element's size is
+ * calculated rather than while drawing. */
+static ElementTextLayout2 *
+TextAllocLayout2(
+    TreeCtrl *tree,
+    TreeElement elem
+    )
+{
+    DynamicOption *opt;
+    ElementTextLayout2 *etl2;
+
+    etl2 = DynamicOption_FindData(elem->options, 1007);
+    if (etl2 == NULL) {
+	opt = (DynamicOption *) DynamicOption_AllocIfNeeded(tree,
+	    &elem->options, 1007, sizeof(ElementTextLayout2), NULL);
+	etl2 = (ElementTextLayout2 *) opt->data;
+	/* It is possible that the needed size of this element does not
+	 * require a TextLayout, in which case neededWidth never gets
+	 * set. */
+	etl2->layoutWidth = -1;
+	etl2->neededWidth = -1;
+	etl2->fitWidth = -1;
+    }
+    return etl2;
+}
+
 static ElementTextLayout2 *
 TextUpdateLayout(
     char *func,
     TreeElementArgs *args,
     int fixedWidth,
-    int maxWidth
+    int maxWidth,
+    int reflow			/* TRUE if only the available width changed
+				 * since the layout was last computed. */
     )
 {
     TreeCtrl *tree = args->tree;
@@ -2720,6 +3335,7 @@ TextUpdateLayout(
     ElementText *elemX = (ElementText *) elem;
     ElementText *masterX = (ElementText *) elem->master;
     int state = args->state;
+    TextLayout oldLayout = NULL;
     Tk_Font tkfont;
     char *text = NULL;
     int textLen = 0;
@@ -2732,7 +3348,6 @@ TextUpdateLayout(
     int textWidth;
     ElementTextLayout *etl, *etlM = NULL;
     ElementTextLayout2 *etl2;
-    DynamicOption *opt;
 
     if (tree->debug.enable && tree->debug.textLayout)
 	dbwin("TextUpdateLayout: %s %p (%s) %s\n    fixedWidth %d maxWidth %d\n",
@@ -2740,10 +3355,16 @@ TextUpdateLayout(
 	    func, fixedWidth, maxWidth);
 
     etl2 = DynamicOption_FindData(elem->options, 1007);
+    if (etl2 != NULL)
+	etl2->fitWidth = -1;
     if (etl2 != NULL && etl2->layout != NULL) {
 	if (tree->debug.enable && tree->debug.textLayout)
 	    dbwin("    FREE\n");
-	TextLayout_Free(etl2->layout);
+	/* Keep the old layout so its word widths can be reused. */
+	if (reflow)
+	    oldLayout = etl2->layout;
+	else
+	    TextLayout_Free(etl2->layout);
 	etl2->layout = NULL;
     }
 
@@ -2755,7 +3376,7 @@ TextUpdateLayout(
 	textLen = masterX->textLen;
     }
     if ((text == NULL) || (textLen == 0))
-	return etl2;
+	goto done;
 
     etl = DynamicOption_FindData(elem->options, 1005);
     if (masterX != NULL)
@@ -2766,7 +3387,7 @@ TextUpdateLayout(
     else if (etlM != NULL && etlM->lines != -1)
 	lines = etlM->lines;
     if (lines == 1)
-	return etl2;
+	goto done;
 
     tkfont = DO_FontForState(tree, elem, 1004, state);
     if (tkfont == NULL)
@@ -2802,11 +3423,11 @@ TextUpdateLayout(
 		lines, multiLine, width, textWrapST[wrap]);
     if (!multiLine) {
 	if (width == 0)
-	    return etl2;
-	textWidth = Tk_TextWidth(tkfont, text, textLen);
+	    goto done;
+	textWidth = Tree_TextWidth(tree, tkfont, text, textLen);
 if (tree->debug.enable && tree->debug.textLayout) dbwin("    available width %d textWidth %d\n", width, textWidth);
 	if (width >= textWidth)
-	    return etl2;
+	    goto done;
     }
 
     if (etl != NULL && etl->justify != TK_JUSTIFY_NULL)
@@ -2817,60 +3438,205 @@ if (tree->debug.enable && tree->debug.textLayout) dbwin("    available width %d
     if (wrap == TEXT_WRAP_WORD)
 	flags |= TK_WHOLE_WORDS;
 
-    if (etl2 == NULL) {
-	opt = (DynamicOption *) DynamicOption_AllocIfNeeded(tree,
-	    &elem->options, 1007, sizeof(ElementTextLayout2), NULL);
-	etl2 = (ElementTextLayout2 *) opt->data;
-	/* It is possible that the needed size of this element does not
-	 * require a TextLayout, in which case neededWidth never gets
-	 * set. */
-	etl2->neededWidth = -1;
-    }
+    if (etl2 == NULL)
+	etl2 = TextAllocLayout2(tree, elem);
 
-    etl2->layout = TextLayout_Compute(tkfont, text,
+    etl2->layout = TextLayout_Reflow(tree, oldLayout, tkfont, text,
 	    Tcl_NumUtfChars(text, textLen), width, justify, lines, flags);
+    oldLayout = NULL;
 
     if (tree->debug.enable && tree->debug.textLayout)
 	dbwin("    ALLOC\n");
+done:
+    if (oldLayout != NULL)
+	TextLayout_Free(oldLayout);
     return etl2;
 }
 
 #ifdef TEXTVAR
+
+/*
+ * All the text elements in a widget with the same -textvariable share a
+ * single variable trace. Writing the variable adds the elements to a set
+ * of pending elements, and the changes are reported once at idle time
+ * no matter how many times the variables were written.
+ */
+
+typedef struct TextVarTrace {
+    TreeCtrl *tree;		/* Widget info. */
+    Tcl_HashEntry *hPtr;	/* Entry in TreeTextVars.traceHash. */
+    ElementTextVar *watchers;	/* Elements with this -textvariable. */
+    int numPending;		/* Number of watchers in
+				 * TreeTextVars.pendingHash. */
+    Tcl_Obj *valueObj;		/* Value last written to the variable
+				 * while numPending > 0, otherwise NULL.
+				 * Recreates the variable if it is unset
+				 * before the watchers are updated. Not
+				 * kept longer so the value isn't shared
+				 * and can be appended to in place. */
+} TextVarTrace;
+
+struct TreeTextVars {
+    Tcl_HashTable traceHash;	/* Variable name -> TextVarTrace. */
+    Tcl_HashTable pendingHash;	/* Elements whose variable was written
+				 * since the last TextVar_IdleProc. */
+    int idlePending;		/* TRUE if TextVar_IdleProc is
+				 * scheduled. */
+};
+
+#define TEXTVAR_TRACE_FLAGS \
+    (TCL_GLOBAL_ONLY | TCL_TRACE_WRITES | TCL_TRACE_UNSETS)
+
 static Tcl_VarTraceProc VarTraceProc_Text;
 
-static void TextTraceSet(Tcl_Interp *interp, ElementText *elemX)
+static void TextTraceSet(TreeCtrl *tree, ElementText *elemX)
 {
     ElementTextVar *etv = DynamicOption_FindData(elemX->header.options, 1001);
     Tcl_Obj *varNameObj = etv ? etv->varNameObj : NULL;
+    TreeTextVars *tv = tree->textVars;
+    TextVarTrace *trace;
+    Tcl_HashEntry *hPtr;
+    int isNew;
 
-    if (varNameObj != NULL) {
-	Tcl_TraceVar2(interp, Tcl_GetString(varNameObj),
-	    NULL,
-	    TCL_GLOBAL_ONLY | TCL_TRACE_WRITES | TCL_TRACE_UNSETS,
-	    VarTraceProc_Text, (ClientData) elemX);
+    if (varNameObj == NULL)
+	return;
+
+    if (tv == NULL) {
+	tv = (TreeTextVars *) ckalloc(sizeof(TreeTextVars));
+	Tcl_InitHashTable(&tv->traceHash, TCL_STRING_KEYS);
+	Tcl_InitHashTable(&tv->pendingHash, TCL_ONE_WORD_KEYS);
+	tv->idlePending = FALSE;
+	tree->textVars = tv;
     }
+
+    hPtr = Tcl_CreateHashEntry(&tv->traceHash, Tcl_GetString(varNameObj),
+	&isNew);
+    if (isNew) {
+	trace = (TextVarTrace *) ckalloc(sizeof(TextVarTrace));
+	trace->tree = tree;
+	trace->hPtr = hPtr;
+	trace->watchers = NULL;
+	trace->numPending = 0;
+	trace->valueObj = NULL;
+	Tcl_SetHashValue(hPtr, (ClientData) trace);
+	Tcl_TraceVar2(tree->interp, Tcl_GetString(varNameObj),
+	    NULL, TEXTVAR_TRACE_FLAGS,
+	    VarTraceProc_Text, (ClientData) trace);
+    } else {
+	trace = (TextVarTrace *) Tcl_GetHashValue(hPtr);
+    }
+
+    etv->elemX = elemX;
+    etv->trace = trace;
+    etv->prevWatcher = NULL;
+    etv->nextWatcher = trace->watchers;
+    if (trace->watchers != NULL)
+	trace->watchers->prevWatcher = etv;
+    trace->watchers = etv;
 }
 
-static void TextTraceUnset(Tcl_Interp *interp, ElementText *elemX)
+/* Called when a watcher of a trace is no longer pending. The last value
+ * written is released with the last pending watcher. */
+static void TextVarTrace_DonePending(TextVarTrace *trace)
+{
+    if ((--trace->numPending == 0) && (trace->valueObj != NULL)) {
+	Tcl_DecrRefCount(trace->valueObj);
+	trace->valueObj = NULL;
+    }
+}
+
+static void TextTraceUnset(TreeCtrl *tree, ElementText *elemX)
 {
     ElementTextVar *etv = DynamicOption_FindData(elemX->header.options, 1001);
-    Tcl_Obj *varNameObj = etv ? etv->varNameObj : NULL;
+    TreeTextVars *tv = tree->textVars;
+    TextVarTrace *trace = etv ? etv->trace : NULL;
+    Tcl_HashEntry *hPtr;
 
-    if (varNameObj != NULL) {
-	Tcl_UntraceVar2(interp, Tcl_GetString(varNameObj),
-	    NULL,
-	    TCL_GLOBAL_ONLY | TCL_TRACE_WRITES | TCL_TRACE_UNSETS,
-	    VarTraceProc_Text, (ClientData) elemX);
+    if (trace == NULL)
+	return;
+
+    if (etv->prevWatcher != NULL)
+	etv->prevWatcher->nextWatcher = etv->nextWatcher;
+    else
+	trace->watchers = etv->nextWatcher;
+    if (etv->nextWatcher != NULL)
+	etv->nextWatcher->prevWatcher = etv->prevWatcher;
+    etv->trace = NULL;
+    etv->prevWatcher = NULL;
+    etv->nextWatcher = NULL;
+
+    hPtr = Tcl_FindHashEntry(&tv->pendingHash, (char *) elemX);
+    if (hPtr != NULL) {
+	Tcl_DeleteHashEntry(hPtr);
+	TextVarTrace_DonePending(trace);
+    }
+
+    if (trace->watchers == NULL) {
+	Tcl_UntraceVar2(tree->interp,
+	    Tcl_GetHashKey(&tv->traceHash, trace->hPtr),
+	    NULL, TEXTVAR_TRACE_FLAGS,
+	    VarTraceProc_Text, (ClientData) trace);
+	Tcl_DeleteHashEntry(trace->hPtr);
+	ckfree((char *) trace);
+    }
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TextVar_IdleProc --
+ *
+ *	Called at idle time after -textvariable variables were written.
+ *	Invalidates the string rep and size of every element whose
+ *	variable changed.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Items and columns are marked for relayout and redisplay.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+TextVar_IdleProc(
+    ClientData clientData	/* Widget info. */
+    )
+{
+    TreeCtrl *tree = (TreeCtrl *) clientData;
+    TreeTextVars *tv = tree->textVars;
+    ElementText *elemX;
+    ElementTextVar *etv;
+    Tcl_HashEntry *hPtr;
+    Tcl_HashSearch search;
+
+    tv->idlePending = FALSE;
+
+    hPtr = Tcl_FirstHashEntry(&tv->pendingHash, &search);
+    while (hPtr != NULL) {
+	elemX = (ElementText *) Tcl_GetHashKey(&tv->pendingHash, hPtr);
+	etv = DynamicOption_FindData(elemX->header.options, 1001);
+	elemX->textLen = STRINGREP_INVALID;
+	Tree_ElementChangedItself(tree, etv->item, etv->column,
+	    (TreeElement) elemX, TEXT_CONF_TEXTVAR, CS_LAYOUT | CS_DISPLAY);
+	TextVarTrace_DonePending(etv->trace);
+	hPtr = Tcl_NextHashEntry(&search);
     }
+    Tcl_DeleteHashTable(&tv->pendingHash);
+    Tcl_InitHashTable(&tv->pendingHash, TCL_ONE_WORD_KEYS);
 }
 
 static char *VarTraceProc_Text(ClientData clientData, Tcl_Interp *interp,
     CONST char *name1, CONST char *name2, int flags)
 {
-    ElementText *elemX = (ElementText *) clientData;
-    ElementTextVar *etv = DynamicOption_FindData(elemX->header.options, 1001);
-    Tcl_Obj *varNameObj = etv ? etv->varNameObj : NULL;
-    Tcl_Obj *valueObj;
+    TextVarTrace *trace = (TextVarTrace *) clientData;
+    TreeTextVars *tv = trace->tree->textVars;
+    CONST char *varName = Tcl_GetHashKey(&tv->traceHash, trace->hPtr);
+    ElementTextVar *etv;
+    ElementText *elemX;
+    Tcl_Obj *valueObj = NULL;
+    int isNew;
 
     /*
      * If the variable is unset, then immediately recreate it unless
@@ -2879,28 +3645,145 @@ static char *VarTraceProc_Text(ClientData clientData, Tcl_Interp *interp,
 
     if (flags & TCL_TRACE_UNSETS) {
 	if ((flags & TCL_TRACE_DESTROYED) && !(flags & TCL_INTERP_DESTROYED)) {
-	    /* Use the current string if it is valid. */
-	    if (elemX->textLen > 0) {
-		valueObj = Tcl_NewStringObj(elemX->text, elemX->textLen);
-	    } else {
-		valueObj = Tcl_NewStringObj("", 0);
+	    /* The string of a pending element is out of date, so use the
+	     * last value written, or else the current string of an
+	     * element if it is valid. */
+	    valueObj = trace->valueObj;
+	    for (etv = trace->watchers;
+		    (valueObj == NULL) && (etv != NULL);
+		    etv = etv->nextWatcher) {
+		elemX = etv->elemX;
+		if (elemX->textLen > 0) {
+		    valueObj = Tcl_NewStringObj(elemX->text, elemX->textLen);
+		    break;
+		}
 	    }
+	    if (valueObj == NULL)
+		valueObj = Tcl_NewStringObj("", 0);
 	    Tcl_IncrRefCount(valueObj);
-	    Tcl_ObjSetVar2(interp, varNameObj, NULL, valueObj,
-		TCL_GLOBAL_ONLY);
+	    Tcl_SetVar2Ex(interp, varName, NULL, valueObj, TCL_GLOBAL_ONLY);
 	    Tcl_DecrRefCount(valueObj);
-	    TextTraceSet(interp, elemX);
+	    Tcl_TraceVar2(interp, varName, NULL, TEXTVAR_TRACE_FLAGS,
+		VarTraceProc_Text, clientData);
 	}
 	return (char *) NULL;
     }
 
-    elemX->textLen = STRINGREP_INVALID;
-    Tree_ElementChangedItself(etv->tree, etv->item, etv->column,
-	(TreeElement) elemX, TEXT_CONF_TEXTVAR, CS_LAYOUT | CS_DISPLAY);
+    valueObj = Tcl_GetVar2Ex(interp, varName, NULL, TCL_GLOBAL_ONLY);
+    if (valueObj != NULL)
+	Tcl_IncrRefCount(valueObj);
+    if (trace->valueObj != NULL)
+	Tcl_DecrRefCount(trace->valueObj);
+    trace->valueObj = valueObj;
+
+    for (etv = trace->watchers; etv != NULL; etv = etv->nextWatcher) {
+	(void) Tcl_CreateHashEntry(&tv->pendingHash, (char *) etv->elemX,
+	    &isNew);
+	if (isNew)
+	    trace->numPending++;
+    }
+    if (!tv->idlePending) {
+	Tcl_DoWhenIdle(TextVar_IdleProc, (ClientData) trace->tree);
+	tv->idlePending = TRUE;
+    }
     return (char *) NULL;
 }
 #endif /* TEXTVAR */
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * TreeElement_UpdateTextVars --
+ *
+ *	Update the text elements whose -textvariable was written
+ *	since the last time, without waiting for TextVar_IdleProc.
+ *	Called before anything that uses the text or size of an
+ *	element.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Items and columns may be marked for relayout and redisplay.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+TreeElement_UpdateTextVars(
+    TreeCtrl *tree		/* Widget info. */
+    )
+{
+#ifdef TEXTVAR
+    TreeTextVars *tv = tree->textVars;
+
+    if ((tv != NULL) && tv->idlePending) {
+	Tcl_CancelIdleCall(TextVar_IdleProc, (ClientData) tree);
+	TextVar_IdleProc((ClientData) tree);
+    }
+#endif
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TreeElement_Free --
+ *
+ *	Free element-related resources for a deleted TreeCtrl. This is
+ *	called after all the elements have been deleted.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Memory is freed.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+TreeElement_Free(
+    TreeCtrl *tree		/* Widget info. */
+    )
+{
+    Tcl_HashEntry *hPtr;
+    Tcl_HashSearch search;
+    TextFormat *tf;
+
+    if (tree->textFormatHash != NULL) {
+	hPtr = Tcl_FirstHashEntry(tree->textFormatHash, &search);
+	while (hPtr != NULL) {
+	    tf = (TextFormat *) Tcl_GetHashValue(hPtr);
+	    if (tf->prefix != NULL)
+		ckfree(tf->prefix);
+	    if (tf->suffix != NULL)
+		ckfree(tf->suffix);
+	    if (tf->timeFormat != NULL)
+		ckfree(tf->timeFormat);
+	    if (tf->tclFormatObj != NULL)
+		Tcl_DecrRefCount(tf->tclFormatObj);
+	    ckfree((char *) tf);
+	    hPtr = Tcl_NextHashEntry(&search);
+	}
+	Tcl_DeleteHashTable(tree->textFormatHash);
+	ckfree((char *) tree->textFormatHash);
+	tree->textFormatHash = NULL;
+    }
+
+#ifdef TEXTVAR
+    if (tree->textVars != NULL) {
+	TreeTextVars *tv = tree->textVars;
+
+	if (tv->idlePending)
+	    Tcl_CancelIdleCall(TextVar_IdleProc, (ClientData) tree);
+	Tcl_DeleteHashTable(&tv->traceHash);
+	Tcl_DeleteHashTable(&tv->pendingHash);
+	ckfree((char *) tv);
+	tree->textVars = NULL;
+    }
+#endif
+}
+
 static void DeleteProcText(TreeElementArgs *args)
 {
     TreeCtrl *tree = args->tree;
@@ -2917,7 +3800,7 @@ static void DeleteProcText(TreeElementArgs *args)
 	TextLayout_Free(etl2->layout);
     DynamicOption_Free1(tree, &elem->options, 1007, sizeof(ElementTextLayout2));
 #ifdef TEXTVAR
-    TextTraceUnset(tree->interp, elemX);
+    TextTraceUnset(tree, elemX);
 #endif
 }
 
@@ -2937,7 +3820,7 @@ static int ConfigProcText(TreeElementArgs *args)
 #endif
 
 #ifdef TEXTVAR
-    TextTraceUnset(interp, elemX);
+    TextTraceUnset(tree, elemX);
 #endif
 
     for (error = 0; error <= 1; error++) {
@@ -2994,7 +3877,7 @@ static int ConfigProcText(TreeElementArgs *args)
 	elemX->text = NULL;
 
 #ifdef TEXTVAR
-    TextTraceSet(interp, elemX);
+    TextTraceSet(tree, elemX);
 #endif
 
     if (error) {
@@ -3070,7 +3953,7 @@ TextRedoLayoutIfNeeded(
 	    doLayout = 1;
     }
     if (doLayout)
-	etl2 = TextUpdateLayout(func, args, fixedWidth, -1);
+	etl2 = TextUpdateLayout(func, args, fixedWidth, -1, TRUE);
     if (etl2 != NULL)
 	etl2->layoutWidth = (etl2->layout != NULL) ? fixedWidth : -1;
     return etl2;
@@ -3190,9 +4073,28 @@ static void DisplayProcText(TreeElementArgs *args)
 
     Tk_GetFontMetrics(tkfont, &fm);
 
-    pixelsForText = args->display.width;
-    bytesThatFit = Tree_Ellipsis(tkfont, text, textLen, &pixelsForText,
-	    ellipsis, FALSE);
+    /* Redrawing at the same width doesn't need to measure the text
+     * again to find where to put the ellipsis. */
+    if ((etl2 != NULL) && (etl2->fitWidth == args->display.width) &&
+	    (etl2->fitFont == tkfont) && (etl2->fitText == text) &&
+	    (etl2->fitTextLen == textLen)) {
+	bytesThatFit = etl2->fitBytes;
+	pixelsForText = etl2->fitPixels;
+    } else {
+	pixelsForText = args->display.width;
+	bytesThatFit = Tree_Ellipsis(tree, tkfont, text, textLen, &pixelsForText,
+		ellipsis, FALSE);
+	/* Drawing never allocates; NeededProcText() and HeightProcText()
+	 * allocate etl2 when the text may not fit. */
+	if ((etl2 != NULL) && (bytesThatFit != textLen)) {
+	    etl2->fitWidth = args->display.width;
+	    etl2->fitFont = tkfont;
+	    etl2->fitText = text;
+	    etl2->fitTextLen = textLen;
+	    etl2->fitBytes = bytesThatFit;
+	    etl2->fitPixels = pixelsForText;
+	}
+    }
     width = pixelsForText, height = fm.linespace;
     /* Hack -- The actual size of the text may be slightly smaller than
     * the available space when squeezed. If so we don't want to center
@@ -3287,7 +4189,7 @@ static void NeededProcText(TreeElementArgs *args)
     }
 
     etl2 = TextUpdateLayout("NeededProcText", args, args->needed.fixedWidth,
-	    args->needed.maxWidth);
+	    args->needed.maxWidth, FALSE);
     if (etl2 != NULL) {
 	etl2->layoutWidth = -1;
 	etl2->neededWidth = -1;
@@ -3324,11 +4226,21 @@ static void NeededProcText(TreeElementArgs *args)
 	    if (tkfont == NULL)
 		tkfont = tree->tkfont;
 
-	    width = Tk_TextWidth(tkfont, text, textLen);
+	    width = Tree_TextWidth(tree, tkfont, text, textLen);
 	    if (etl != NULL && etl->widthObj != NULL)
 		maxWidth = etl->width;
 	    else if ((etlM != NULL) && (etlM->widthObj != NULL))
 		maxWidth = etlM->width;
+
+	    /* The text will be drawn with an ellipsis if it is given
+	     * less width than it needs. */
+	    if (((maxWidth >= 0) && (maxWidth < width)) ||
+		    ((args->needed.fixedWidth >= 0) &&
+		    (args->needed.fixedWidth < width)) ||
+		    ((args->needed.maxWidth >= 0) &&
+		    (args->needed.maxWidth < width)))
+		(void) TextAllocLayout2(tree, elem);
+
 	    if ((maxWidth >= 0) && (maxWidth < width))
 		width = maxWidth;
 
@@ -3373,6 +4285,10 @@ static void HeightProcText(TreeElementArgs *args)
 		tkfont = tree->tkfont;
 	    Tk_GetFontMetrics(tkfont, &fm);
 	    height = fm.linespace;
+
+	    /* This is only called when the element is squeezed, so the
+	     * text will be drawn with an ellipsis. */
+	    (void) TextAllocLayout2(tree, elem);
 	}
     }
 
@@ -3925,6 +4841,11 @@ static void DisplayProcWindow(TreeElementArgs *args)
 #endif
     int requests;
 
+    /* The [render] command draws views that may not be on the screen.
+     * Leave the window where the last real display put it. */
+    if (args->display.offscreen)
+	return;
+
 #ifdef DEPRECATED
     BOOLEAN_FOR_STATE(draw, draw, state);
     if (!draw)
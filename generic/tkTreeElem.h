@@ -44,6 +44,7 @@ struct TreeElementArgs
 	TreeDrawable td;
 	Drawable drawable;
 	int bounds[4];
+	int offscreen;	/* TRUE if not drawing to the window. */
     } display;
     struct {
 	int fixedWidth;
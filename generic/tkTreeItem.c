@@ -3311,11 +3311,28 @@ Item_HeightOfStyles(
     Column *column = item->columns;
     TreeColumn treeColumn = tree->columns;
     StyleDrawArgs drawArgs;
-    int height = 0;
+    int height = 0, offset, minX = 0, maxX = 0;
+    int onScreenOnly = FALSE;
 
     drawArgs.tree = tree;
 
+    /* With -heightfromvisiblecolumns only the locked columns and the
+     * unlocked columns that are scrolled into view are measured. */
+    if (tree->heightFromVisibleColumns && tree->vertical &&
+	    (tree->wrapMode == TREE_WRAP_NONE)) {
+	minX = tree->xOrigin + Tree_ContentLeft(tree);
+	maxX = tree->xOrigin + Tree_ContentRight(tree);
+	onScreenOnly = TRUE;
+    }
+
+again:
     while (column != NULL) {
+	if (onScreenOnly && TreeColumn_Lock(treeColumn) == COLUMN_LOCK_NONE) {
+	    offset = TreeColumn_Offset(treeColumn);
+	    if ((offset >= maxX) ||
+		    (offset + TreeColumn_UseWidth(treeColumn) <= minX))
+		goto next;
+	}
 	if (TreeColumn_Visible(treeColumn) && (column->style != NULL)) {
 	    drawArgs.state = item->state | column->cstate;
 	    drawArgs.style = column->style;
@@ -3328,10 +3345,19 @@ Item_HeightOfStyles(
 		drawArgs.width = -1;
 	    height = MAX(height, TreeStyle_UseHeight(&drawArgs));
 	}
+next:
 	treeColumn = TreeColumn_Next(treeColumn);
 	column = column->next;
     }
 
+    /* Nothing is onscreen, so measure every column. */
+    if (onScreenOnly && (height == 0)) {
+	column = item->columns;
+	treeColumn = tree->columns;
+	onScreenOnly = FALSE;
+	goto again;
+    }
+
     return height;
 }
 
@@ -3671,6 +3697,16 @@ ItemDrawBackground(
     GC gc = None;
 
     gc = TreeColumn_BackgroundGC(treeColumn, index);
+
+    /* With no -itembackground color, copy from the pre-tiled
+     * -backgroundimage which is already painted over -background. */
+    if ((gc == None) && (tree->backgroundImage != NULL)) {
+	Tree_DrawBackgroundImage(tree, drawable.drawable, x, y,
+		x + width, y + height,
+		tree->drawableXOrigin, tree->drawableYOrigin);
+	return;
+    }
+
     if (gc == None)
 	gc = Tk_3DBorderGC(tree->tkwin, tree->border, TK_3D_FLAT_GC);
     /*
@@ -4970,7 +5006,8 @@ ItemCreateCmd(
 	    if (style != NULL) {
 		Column *column = Item_CreateColumn(tree, item,
 			TreeColumn_Index(treeColumn), NULL);
-		column->style = TreeStyle_NewInstance(tree, style);
+		column->style = TreeStyle_NewInstance(tree, style, item,
+			(TreeItemColumn) column);
 	    }
 	}
 #ifdef DEPRECATED
@@ -4984,7 +5021,8 @@ ItemCreateCmd(
 		    continue;
 		if (tree->defaultStyle.styles[i] != NULL) {
 		    column->style = TreeStyle_NewInstance(tree,
-			    tree->defaultStyle.styles[i]);
+			    tree->defaultStyle.styles[i], item,
+			    (TreeItemColumn) column);
 		}
 	    }
 	}
@@ -5378,11 +5416,11 @@ if (co[indexElem].numArgs == -1) panic("indexElem=%d (%s) objc=%d numArgs == -1"
 			    indexElem = index2;
 			}
 
+			/* TreeStyle_ElementConfigure() takes care of
+			 * CS_DISPLAY. */
 			if (cMask & CS_LAYOUT) {
 			    TreeItemColumn_InvalidateSize(tree, (TreeItemColumn) column);
 			    Tree_InvalidateColumnWidth(tree, treeColumn);
-			} else if (cMask & CS_DISPLAY) {
-			    Tree_InvalidateItemDInfo(tree, treeColumn, item, NULL);
 			}
 			iMask |= cMask;
 			if (result != TCL_OK)
@@ -5539,7 +5577,8 @@ ItemStyleCmd(
 			    break;
 			}
 		    } else {
-			column->style = TreeStyle_NewInstance(tree, style);
+			column->style = TreeStyle_NewInstance(tree, style,
+				item, (TreeItemColumn) column);
 		    }
 		    TreeItemColumn_InvalidateSize(tree, (TreeItemColumn) column);
 		    Tree_InvalidateColumnWidth(tree, treeColumn);
@@ -5649,7 +5688,7 @@ doneMAP:
 					(TreeItemColumn) column);
 			    }
 			    column->style = TreeStyle_NewInstance(tree,
-				    cs[i].style);
+				    cs[i].style, item, (TreeItemColumn) column);
 			}
 			TreeItemColumn_InvalidateSize(tree,
 				(TreeItemColumn) column);
@@ -5846,6 +5885,96 @@ DictionaryCompare(
     return diff;
 }
 
+#ifdef TREECTRL_BENCH
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TreeItem_BenchDictionaryCompare --
+ *
+ *	Call DictionaryCompare() repeatedly for the [treectrl::bench]
+ *	command.
+ *
+ * Results:
+ *	Result of the last comparison.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+int
+TreeItem_BenchDictionaryCompare(
+    char *left,			/* First string. */
+    char *right,		/* Second string. */
+    int iterations		/* Number of times to compare. */
+    )
+{
+    int i, result = 0;
+
+    for (i = 0; i < iterations; i++)
+	result = DictionaryCompare(left, right);
+    return result;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TreeItem_BenchLayout --
+ *
+ *	Lay out the style in one column of an item repeatedly for the
+ *	[treectrl::bench] command. The arguments to the style code are
+ *	set up the same way as TreeItem_WalkSpans() does.
+ *
+ * Results:
+ *	A standard Tcl result.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+int
+TreeItem_BenchLayout(
+    TreeCtrl *tree,		/* Widget info. */
+    TreeItem item,		/* Item token. */
+    TreeColumn treeColumn,	/* Column token. */
+    int iterations		/* Number of times to lay out. */
+    )
+{
+    int columnIndex = TreeColumn_Index(treeColumn);
+    Column *itemColumn = (Column *) TreeItem_FindColumn(tree, item,
+	    columnIndex);
+    StyleDrawArgs drawArgs;
+
+    if ((itemColumn == NULL) || (itemColumn->style == NULL)) {
+	NoStyleMsg(tree, item, columnIndex);
+	return TCL_ERROR;
+    }
+
+    drawArgs.tree = tree;
+    drawArgs.td.drawable = None;
+    drawArgs.bounds[0] = drawArgs.bounds[1] =
+    drawArgs.bounds[2] = drawArgs.bounds[3] = 0;
+    drawArgs.state = item->state | itemColumn->cstate;
+    drawArgs.style = itemColumn->style;
+    if (treeColumn == tree->columnTree)
+	drawArgs.indent = TreeItem_Indent(tree, item);
+    else
+	drawArgs.indent = 0;
+    drawArgs.x = drawArgs.y = 0;
+    drawArgs.width = TreeColumn_UseWidth(treeColumn);
+    drawArgs.height = TreeItem_Height(tree, item);
+    drawArgs.justify = TreeColumn_ItemJustify(treeColumn);
+
+    TreeStyle_BenchLayoutH(&drawArgs, iterations);
+    return TCL_OK;
+}
+
+#endif /* TREECTRL_BENCH */
+
 static int
 CompareAscii(
     SortData *sortData,
@@ -8374,6 +8503,7 @@ SpanWalkProc_Identify(
     struct {
 	int x;
 	int y;
+	int rowOnly;
 	char *buf;
     } *data = clientData;
 
@@ -8384,8 +8514,9 @@ SpanWalkProc_Identify(
     sprintf(data->buf + strlen(data->buf), " column %s%d",
 	    tree->columnPrefix, TreeColumn_GetID(spanPtr->treeColumn));
 
-    if (drawArgs->style != NULL) {
-	char *elem = TreeStyle_Identify(drawArgs, data->x, data->y);
+    if ((drawArgs->style != NULL) && !data->rowOnly) {
+	char *elem = TreeStyle_Identify(drawArgs, data->x, data->y,
+		TreeDisplay_ItemHitCache(tree, item));
 	if (elem != NULL)
 	    sprintf(data->buf + strlen(data->buf), " elem %s", elem);
     }
@@ -8404,7 +8535,7 @@ SpanWalkProc_Identify(
  *	If the Item is not ReallyVisible() or no columns are visible
  *	then buf[] is untouched. Otherwise the given string may be
  *	appended with "column C" followed by "elem E" although both
- *	are optional.
+ *	are optional. "elem E" is never appended if rowOnly is TRUE.
  *
  * Side effects:
  *	None.
@@ -8418,6 +8549,8 @@ TreeItem_Identify(
     TreeItem item,		/* Item token. */
     int lock,			/* Columns to hit-test. */
     int x, int y,		/* Item coords to hit-test with. */
+    int rowOnly,		/* TRUE if elements should not be
+				 * hit-tested. */
     char *buf			/* NULL-terminated string which may be
 				 * appended. */
     )
@@ -8426,6 +8559,7 @@ TreeItem_Identify(
     struct {
 	int x;
 	int y;
+	int rowOnly;
 	char *buf;
     } clientData;
 
@@ -8436,6 +8570,7 @@ TreeItem_Identify(
     /* Tree_ItemBbox returns canvas coords. x/y are item coords. */
     clientData.x = x;
     clientData.y = y;
+    clientData.rowOnly = rowOnly;
     clientData.buf = buf;
 
     TreeItem_WalkSpans(tree, item, lock,
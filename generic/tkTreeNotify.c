@@ -799,6 +799,31 @@ TreeNotify_ItemVisibility(
     (void) QE_BindEvent(tree->bindingTable, &event);
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * TreeNotify_WantItemVisibility --
+ *
+ *	Determine whether there are any bindings on the <ItemVisibility>
+ *	event.
+ *
+ * Results:
+ *	TRUE if TreeNotify_ItemVisibility() would evaluate any scripts.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+int
+TreeNotify_WantItemVisibility(
+    TreeCtrl *tree		/* Widget info. */
+    )
+{
+    return QE_BindingExists(tree->bindingTable, EVENT_ITEM_VISIBILITY, 0);
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -27,6 +27,7 @@ typedef struct MStyle MStyle;
 typedef struct IStyle IStyle;
 typedef struct MElementLink MElementLink;
 typedef struct IElementLink IElementLink;
+typedef struct SharedElems SharedElems;
 
 /*
  * A data structure of the following type is kept for each master style.
@@ -40,18 +41,33 @@ struct MStyle
     int numElements;		/* Size of elements[]. */
     MElementLink *elements;	/* Array of master elements. */
     int vertical;		/* -orient */
+    IStyle *instances;		/* Every instance of this style. */
+    SharedElems *shared;	/* Arrays of master elements shared by
+				 * instances, one per state. */
 };
 
 /*
  * A data structure of the following type is kept for each instance style.
  * Instance styles are created when a style is assigned to an item-column.
+ * Until one of its elements is configured an instance style uses an array
+ * of master elements shared with the other instances of its master style
+ * in the same state.
  */
 struct IStyle
 {
     MStyle *master;		/* Always non-NULL. */
     IElementLink *elements;	/* Array of master or instance elements. */
+    SharedElems *shared;	/* The shared array elements points to, or
+				 * NULL if elements is private. */
     int neededWidth;		/* Requested size of this style based on */
     int neededHeight;		/* layout of the elements. */
+    TreeRectangle *drawn;	/* Where each element was last drawn,
+				 * relative to the style, or NULL if the
+				 * style was never drawn. */
+    TreeItem item;		/* Item and item-column this style is */
+    TreeItemColumn column;	/* assigned to. */
+    IStyle *prevInstance;	/* Links in the master style's list of */
+    IStyle *nextInstance;	/* instances. */
 #ifdef TREECTRL_DEBUG
     int neededState;
 #endif
@@ -131,6 +147,20 @@ struct IElementLink
 #endif
 };
 
+/*
+ * An array of master elements shared by every instance style of a master
+ * style that hasn't configured any of its elements and was last laid out
+ * in a particular state. Since the elements are the same for every such
+ * instance, so are their cached sizes.
+ */
+struct SharedElems
+{
+    int state;			/* STATE_xxx flags the sizes are for. */
+    int refCount;		/* Number of instance styles using this. */
+    IElementLink *elements;	/* Array of master elements. */
+    SharedElems *next;		/* Next in the master style's list. */
+};
+
 static CONST char *MStyleUid = "MStyle", *IStyleUid = "IStyle",
     *MElementLinkUid = "MElementLink", *IElementLinkUid = "IElementLink";
 
@@ -176,6 +206,8 @@ struct Layout
 
 #define IS_HIDDEN(L) ((L)->visible == 0)
 
+#define IS_SHARED(S) ((S)->shared != NULL)
+
 /*
  *----------------------------------------------------------------------
  *
@@ -2056,6 +2088,132 @@ Style_NeededSize(
     STATIC_FREE(layouts, struct Layout, masterStyle->numElements);
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * IStyle_UnshareElements --
+ *
+ *	Stop an instance style using a shared array of master elements.
+ *	The array is freed when its last user lets go of it.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Memory may be deallocated.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+IStyle_UnshareElements(
+    TreeCtrl *tree,		/* Widget info. */
+    IStyle *style		/* Instance style. */
+    )
+{
+    MStyle *masterStyle = style->master;
+    SharedElems *shared = style->shared, **prevPtr;
+
+    if (shared == NULL)
+	return;
+    style->shared = NULL;
+    style->elements = NULL;
+    if (--shared->refCount > 0)
+	return;
+
+    for (prevPtr = &masterStyle->shared;
+	 *prevPtr != shared;
+	 prevPtr = &(*prevPtr)->next) {
+	/* nothing */
+    }
+    *prevPtr = shared->next;
+    if (masterStyle->numElements > 0) {
+#ifdef ALLOC_HAX
+	TreeAlloc_CFree(tree->allocData, IElementLinkUid,
+		(char *) shared->elements, sizeof(IElementLink),
+		masterStyle->numElements, ELEMENT_LINK_ROUND);
+#else
+	WCFREE(shared->elements, IElementLink, masterStyle->numElements);
+#endif
+    }
+    WFREE(shared, SharedElems);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * IStyle_ShareElements --
+ *
+ *	Make an instance style use the array of master elements its
+ *	master style shares among instances in the given state. The
+ *	array is created if needed.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Memory may be allocated/deallocated.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+IStyle_ShareElements(
+    TreeCtrl *tree,		/* Widget info. */
+    IStyle *style,		/* Instance style with no instance
+				 * elements. */
+    int state			/* STATE_xxx flags. */
+    )
+{
+    MStyle *masterStyle = style->master;
+    SharedElems *shared;
+    IElementLink *eLink;
+    int i;
+
+    for (shared = masterStyle->shared;
+	 shared != NULL;
+	 shared = shared->next) {
+	if (shared->state == state)
+	    break;
+    }
+    if ((shared != NULL) && (shared == style->shared))
+	return;
+
+    if (shared == NULL) {
+	shared = (SharedElems *) ckalloc(sizeof(SharedElems));
+	shared->state = state;
+	shared->refCount = 0;
+	shared->elements = NULL;
+	if (masterStyle->numElements > 0) {
+#ifdef ALLOC_HAX
+	    shared->elements = (IElementLink *) TreeAlloc_CAlloc(
+		    tree->allocData, IElementLinkUid, sizeof(IElementLink),
+		    masterStyle->numElements, ELEMENT_LINK_ROUND);
+#else
+	    shared->elements = (IElementLink *) ckalloc(
+		    sizeof(IElementLink) * masterStyle->numElements);
+#endif
+	    memset(shared->elements, '\0',
+		    sizeof(IElementLink) * masterStyle->numElements);
+	    for (i = 0; i < masterStyle->numElements; i++) {
+		eLink = &shared->elements[i];
+		eLink->elem = masterStyle->elements[i].elem;
+#ifdef CACHE_ELEM_SIZE
+		eLink->neededWidth = -1;
+		eLink->neededHeight = -1;
+#endif
+	    }
+	}
+	shared->next = masterStyle->shared;
+	masterStyle->shared = shared;
+    }
+
+    IStyle_UnshareElements(tree, style);
+    shared->refCount++;
+    style->shared = shared;
+    style->elements = shared->elements;
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -2081,6 +2239,13 @@ Style_CheckNeededSize(
     int state			/* STATE_xxx flags. */
     )
 {
+    /* The sizes cached in a shared array of elements are for the
+     * state of the instances using it. */
+    if (IS_SHARED(style) && (style->shared->state != state)) {
+	IStyle_ShareElements(tree, style, state);
+	style->neededWidth = style->neededHeight = -1;
+    }
+
     if (style->neededWidth == -1) {
 	int minWidth, minHeight;
 
@@ -2285,13 +2450,16 @@ TreeStyle_UseHeight(
  *
  * TreeStyle_Draw --
  *
- *	Draw all the elements in a style.
+ *	Draw all the elements in a style. Elements entirely outside the
+ *	drawable are skipped.
  *
  * Results:
  *	None.
  *
  * Side effects:
- *	Stuff is drawn.
+ *	Stuff is drawn. The rectangle of each element is remembered so
+ *	that a change to a single element can redraw just that part of
+ *	the item.
  *
  *----------------------------------------------------------------------
  */
@@ -2349,9 +2517,18 @@ void TreeStyle_Draw(
     args.state = drawArgs->state;
     args.display.td = drawArgs->td;
     args.display.drawable = drawArgs->td.drawable;
+    args.display.offscreen = tree->drawableOffscreen;
+
+    if ((style->drawn == NULL) && (masterStyle->numElements > 0)) {
+	style->drawn = (TreeRectangle *) ckalloc(sizeof(TreeRectangle) *
+		masterStyle->numElements);
+    }
 
     for (i = 0; i < masterStyle->numElements; i++) {
 	struct Layout *layout = &layouts[i];
+	TreeRectangle *drawn = &style->drawn[i];
+
+	drawn->width = drawn->height = 0;
 
 	if (IS_HIDDEN(layout))
 	    continue;
@@ -2365,6 +2542,19 @@ void TreeStyle_Draw(
 		drawArgs->state, NULL) == 0)
 	    continue;
 
+	drawn->x = layout->x + layout->ePadX[PAD_TOP_LEFT];
+	drawn->y = layout->y + layout->ePadY[PAD_TOP_LEFT];
+	drawn->width = layout->iWidth;
+	drawn->height = layout->iHeight;
+
+	/* When only part of an item is being redrawn the drawable is
+	 * no bigger than the dirty area. */
+	x = drawArgs->x + drawn->x;
+	y = drawArgs->y + drawn->y;
+	if ((x >= drawArgs->td.width) || (x + drawn->width <= 0) ||
+		(y >= drawArgs->td.height) || (y + drawn->height <= 0))
+	    continue;
+
 #ifdef DEBUG_DRAW
 	if (debugDraw && layout->master->onion != NULL)
 	    continue;
@@ -2544,6 +2734,7 @@ TreeStyle_UpdateWindowPositions(
     args.state = drawArgs->state;
     args.display.td = drawArgs->td;
     args.display.drawable = drawArgs->td.drawable;
+    args.display.offscreen = tree->drawableOffscreen;
 
     for (i = 0; i < numElements; i++) {
 	struct Layout *layout = &layouts[i];
@@ -2813,6 +3004,109 @@ MStyle_FreeResources(
 #endif
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * IStyle_ForgetDrawn --
+ *
+ *	Free the element rectangles saved by TreeStyle_Draw. This must
+ *	be called whenever the elements of an instance style are added,
+ *	removed or reordered.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Memory may be deallocated.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+IStyle_ForgetDrawn(
+    IStyle *style		/* Instance style. */
+    )
+{
+    if (style->drawn != NULL) {
+	ckfree((char *) style->drawn);
+	style->drawn = NULL;
+    }
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * MStyle_AddInstance --
+ * MStyle_RemoveInstance --
+ *
+ *	Add or remove an instance style from the list of instances
+ *	kept by its master style. The list lets changes to a master
+ *	style find the item-columns using it without looking at
+ *	every item.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+MStyle_AddInstance(
+    MStyle *masterStyle,	/* Master style. */
+    IStyle *style		/* Instance of masterStyle. */
+    )
+{
+    style->prevInstance = NULL;
+    style->nextInstance = masterStyle->instances;
+    if (masterStyle->instances != NULL)
+	masterStyle->instances->prevInstance = style;
+    masterStyle->instances = style;
+}
+
+static void
+MStyle_RemoveInstance(
+    MStyle *masterStyle,	/* Master style. */
+    IStyle *style		/* Instance of masterStyle. */
+    )
+{
+    if (style->prevInstance != NULL)
+	style->prevInstance->nextInstance = style->nextInstance;
+    else
+	masterStyle->instances = style->nextInstance;
+    if (style->nextInstance != NULL)
+	style->nextInstance->prevInstance = style->prevInstance;
+    style->prevInstance = style->nextInstance = NULL;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * IStyle_TreeColumn --
+ *
+ *	Return the tree column an instance style is displayed in.
+ *
+ * Results:
+ *	Token for the column.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static TreeColumn
+IStyle_TreeColumn(
+    TreeCtrl *tree,		/* Widget info. */
+    IStyle *style		/* Instance style. */
+    )
+{
+    return Tree_FindColumn(tree,
+	TreeItemColumn_Index(tree, style->item, style->column));
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -2838,7 +3132,12 @@ IStyle_FreeResources(
     MStyle *masterStyle = style->master;
     int i;
 
-    if (masterStyle->numElements > 0) {
+    MStyle_RemoveInstance(masterStyle, style);
+    IStyle_ForgetDrawn(style);
+
+    if (IS_SHARED(style)) {
+	IStyle_UnshareElements(tree, style);
+    } else if (masterStyle->numElements > 0) {
 	for (i = 0; i < masterStyle->numElements; i++)
 	    IElementLink_FreeResources(tree, &style->elements[i]);
 #ifdef ALLOC_HAX
@@ -3114,7 +3413,8 @@ Element_CreateAndConfig(
  *
  *	Allocate and initialize a new instance Element in a IStyle
  *	(if it doesn't already exist) and return its associated
- *	IElementLink.
+ *	IElementLink. If the IStyle uses a shared array of master
+ *	elements it is given a private copy of the array first.
  *
  * Results:
  *	If the style already has a matching instance element, then a
@@ -3142,9 +3442,9 @@ Style_CreateElem(
 				 * element was created. */
 {
     MStyle *masterStyle = style->master;
-    IElementLink *eLink = NULL;
+    IElementLink *eLink = NULL, *eLinks;
     TreeElement elem;
-    int i;
+    int i, j;
 
     if (masterElem->master != NULL)
 	panic("Style_CreateElem called with instance Element");
@@ -3171,6 +3471,31 @@ Style_CreateElem(
     if (elem == NULL)
 	return NULL;
 
+    /* Copy-on-write: a shared array never holds instance elements. Its
+     * cached sizes may be for another state than the item-column's. */
+    if (IS_SHARED(style)) {
+#ifdef ALLOC_HAX
+	eLinks = (IElementLink *) TreeAlloc_CAlloc(tree->allocData,
+		IElementLinkUid, sizeof(IElementLink), masterStyle->numElements,
+		ELEMENT_LINK_ROUND);
+#else
+	eLinks = (IElementLink *) ckalloc(sizeof(IElementLink) *
+		masterStyle->numElements);
+#endif
+	memset(eLinks, '\0', sizeof(IElementLink) * masterStyle->numElements);
+	for (j = 0; j < masterStyle->numElements; j++) {
+	    eLinks[j].elem = style->elements[j].elem;
+#ifdef CACHE_ELEM_SIZE
+	    eLinks[j].neededWidth = -1;
+	    eLinks[j].neededHeight = -1;
+#endif
+	}
+	IStyle_UnshareElements(tree, style);
+	style->elements = eLinks;
+	style->neededWidth = style->neededHeight = -1;
+	eLink = &eLinks[i];
+    }
+
     eLink->elem = elem;
     if (isNew != NULL) (*isNew) = TRUE;
     return eLink;
@@ -3184,12 +3509,14 @@ Style_CreateElem(
  *	Create and initialize a new instance of a master style.
  *
  * Results:
- *	A new instance Style. The new array of ElementLinks is
- *	initialized to contain pointers to master elements; instance
- *	elements are created the first time they are configured.
+ *	A new instance Style. It uses the array of master elements
+ *	shared by instances in the same state; a private array is
+ *	made by Style_CreateElem() the first time one of its elements
+ *	is configured.
  *
  * Side effects:
- *	Memory is allocated.
+ *	Memory is allocated. The new style is added to the master
+ *	style's list of instances.
  *
  *----------------------------------------------------------------------
  */
@@ -3197,13 +3524,13 @@ Style_CreateElem(
 TreeStyle
 TreeStyle_NewInstance(
     TreeCtrl *tree,		/* Widget info. */
-    TreeStyle style_		/* Master style to create instance of. */
+    TreeStyle style_,		/* Master style to create instance of. */
+    TreeItem item,		/* Item the instance is for. */
+    TreeItemColumn column	/* Item-column the instance is for. */
     )
 {
     MStyle *style = (MStyle *) style_;
     IStyle *copy;
-    IElementLink *eLink;
-    int i;
 
 #ifdef ALLOC_HAX
     copy = (IStyle *) TreeAlloc_Alloc(tree->allocData, IStyleUid, sizeof(IStyle));
@@ -3214,25 +3541,10 @@ TreeStyle_NewInstance(
     copy->master = style;
     copy->neededWidth = -1;
     copy->neededHeight = -1;
-    if (style->numElements > 0) {
-#ifdef ALLOC_HAX
-	copy->elements = (IElementLink *) TreeAlloc_CAlloc(tree->allocData,
-		IElementLinkUid, sizeof(IElementLink), style->numElements,
-		ELEMENT_LINK_ROUND);
-#else
-	copy->elements = (IElementLink *) ckalloc(sizeof(IElementLink) *
-		style->numElements);
-#endif
-	memset(copy->elements, '\0', sizeof(IElementLink) * style->numElements);
-	for (i = 0; i < style->numElements; i++) {
-	    eLink = &copy->elements[i];
-	    eLink->elem = style->elements[i].elem;
-#ifdef CACHE_ELEM_SIZE
-	    eLink->neededWidth = -1;
-	    eLink->neededHeight = -1;
-#endif
-	}
-    }
+    copy->item = item;
+    copy->column = column;
+    MStyle_AddInstance(style, copy);
+    IStyle_ShareElements(tree, copy, TreeItem_GetState(tree, item));
 
     return (TreeStyle) copy;
 }
@@ -3440,48 +3752,26 @@ Style_Changed(
     MStyle *masterStyle		/* Style that changed. */
     )
 {
-    TreeItem item;
-    TreeItemColumn column;
-    TreeColumn treeColumn;
-    Tcl_HashEntry *hPtr;
-    Tcl_HashSearch search;
-    int columnIndex, layout;
-    int updateDInfo = FALSE;
     IStyle *style;
+    int updateDInfo = FALSE;
 
-    hPtr = Tcl_FirstHashEntry(&tree->itemHash, &search);
-    while (hPtr != NULL) {
-	item = (TreeItem) Tcl_GetHashValue(hPtr);
-	treeColumn = tree->columns;
-	column = TreeItem_GetFirstColumn(tree, item);
-	columnIndex = 0;
-	layout = FALSE;
-	while (column != NULL) {
-	    style = (IStyle *) TreeItemColumn_GetStyle(tree, column);
-	    if ((style != NULL) && (style->master == masterStyle)) {
+    for (style = masterStyle->instances;
+	 style != NULL;
+	 style = style->nextInstance) {
 #ifdef CACHE_ELEM_SIZE
-		int i;
-		for (i = 0; i < masterStyle->numElements; i++) {
-		    IElementLink *eLink = &style->elements[i];
-		    /* This is needed if the -width/-height layout options change */
-		    eLink->neededWidth = eLink->neededHeight = -1;
-		}
-#endif
-		style->neededWidth = style->neededHeight = -1;
-		Tree_InvalidateColumnWidth(tree, treeColumn);
-		TreeItemColumn_InvalidateSize(tree, column);
-		layout = TRUE;
-	    }
-	    columnIndex++;
-	    column = TreeItemColumn_GetNext(tree, column);
-	    treeColumn = TreeColumn_Next(treeColumn);
-	}
-	if (layout) {
-	    TreeItem_InvalidateHeight(tree, item);
-	    Tree_FreeItemDInfo(tree, item, NULL);
-	    updateDInfo = TRUE;
+	int i;
+	for (i = 0; i < masterStyle->numElements; i++) {
+	    IElementLink *eLink = &style->elements[i];
+	    /* This is needed if the -width/-height layout options change */
+	    eLink->neededWidth = eLink->neededHeight = -1;
 	}
-	hPtr = Tcl_NextHashEntry(&search);
+#endif
+	style->neededWidth = style->neededHeight = -1;
+	Tree_InvalidateColumnWidth(tree, IStyle_TreeColumn(tree, style));
+	TreeItemColumn_InvalidateSize(tree, style->column);
+	TreeItem_InvalidateHeight(tree, style->item);
+	Tree_FreeItemDInfo(tree, style->item, NULL);
+	updateDInfo = TRUE;
     }
     if (updateDInfo)
 	Tree_DInfoChanged(tree, DINFO_REDO_RANGES);
@@ -3568,13 +3858,13 @@ MStyle_ChangeElementsAux(
 /*
  *----------------------------------------------------------------------
  *
- * IStyle_ChangeElementsAux --
+ * IElementLink_ChangeArray --
  *
- *	Update the list of elements used by a style. Elements
+ *	Update an array of elements used by an instance style. Elements
  *	may be inserted or deleted.
  *
  * Results:
- *	The list of elements in the style is updated.
+ *	The new array of elements is returned and the old one is freed.
  *
  * Side effects:
  *	Memory may be allocated/deallocated.
@@ -3582,10 +3872,10 @@ MStyle_ChangeElementsAux(
  *----------------------------------------------------------------------
  */
 
-static void
-IStyle_ChangeElementsAux(
+static IElementLink *
+IElementLink_ChangeArray(
     TreeCtrl *tree,		/* Widget info. */
-    IStyle *style,		/* Instance style to be updated. */
+    IElementLink *elements,	/* Array of elements to be updated. */
     int oldCount,		/* The previous number of elements. */
     int count,			/* The number of elements in the style after
 				 * this routine finishes. */
@@ -3615,7 +3905,7 @@ IStyle_ChangeElementsAux(
 
     for (i = 0; i < count; i++) {
 	if (map[i] != -1) {
-	    eLinks[i] = style->elements[map[i]];
+	    eLinks[i] = elements[map[i]];
 	    keep[map[i]] = 1;
 	} else {
 	    eLink = &eLinks[i];
@@ -3630,21 +3920,21 @@ IStyle_ChangeElementsAux(
 	/* Free unused ElementLinks */
 	for (i = 0; i < oldCount; i++) {
 	    if (!keep[i]) {
-		IElementLink_FreeResources(tree, &style->elements[i]);
+		IElementLink_FreeResources(tree, &elements[i]);
 	    }
 	}
 #ifdef ALLOC_HAX
 	TreeAlloc_CFree(tree->allocData, IElementLinkUid,
-		(char *) style->elements, sizeof(IElementLink),
+		(char *) elements, sizeof(IElementLink),
 		oldCount, ELEMENT_LINK_ROUND);
 #else
-	WCFREE(style->elements, IElementLink, oldCount);
+	WCFREE(elements, IElementLink, oldCount);
 #endif
     }
 
     STATIC_FREE(keep, int, oldCount);
 
-    style->elements = eLinks;
+    return eLinks;
 }
 
 /*
@@ -3677,14 +3967,9 @@ Style_ChangeElements(
 				 * currently used by the style. */
     )
 {
-    TreeItem item;
-    TreeItemColumn column;
-    TreeColumn treeColumn;
-    Tcl_HashEntry *hPtr;
-    Tcl_HashSearch search;
-    int columnIndex, layout;
     int updateDInfo = FALSE;
     IStyle *style;
+    SharedElems *shared;
     int i, j, k, oldCount;
 
     /* Update -union lists */
@@ -3738,37 +4023,75 @@ Style_ChangeElements(
     oldCount = masterStyle->numElements;
     MStyle_ChangeElementsAux(tree, masterStyle, count, elemList, map);
 
-    hPtr = Tcl_FirstHashEntry(&tree->itemHash, &search);
-    while (hPtr != NULL) {
-	item = (TreeItem) Tcl_GetHashValue(hPtr);
-	treeColumn = tree->columns;
-	column = TreeItem_GetFirstColumn(tree, item);
-	columnIndex = 0;
-	layout = FALSE;
-	while (column != NULL) {
-	    style = (IStyle *) TreeItemColumn_GetStyle(tree, column);
-	    if ((style != NULL) && (style->master == masterStyle)) {
-		IStyle_ChangeElementsAux(tree, style, oldCount, count, elemList, map);
-		style->neededWidth = style->neededHeight = -1;
-		Tree_InvalidateColumnWidth(tree, treeColumn);
-		TreeItemColumn_InvalidateSize(tree, column);
-		layout = TRUE;
-	    }
-	    columnIndex++;
-	    column = TreeItemColumn_GetNext(tree, column);
-	    treeColumn = TreeColumn_Next(treeColumn);
-	}
-	if (layout) {
-	    TreeItem_InvalidateHeight(tree, item);
-	    Tree_FreeItemDInfo(tree, item, NULL);
-	    updateDInfo = TRUE;
-	}
-	hPtr = Tcl_NextHashEntry(&search);
+    for (shared = masterStyle->shared;
+	 shared != NULL;
+	 shared = shared->next) {
+	shared->elements = IElementLink_ChangeArray(tree, shared->elements,
+		oldCount, count, elemList, map);
+    }
+
+    for (style = masterStyle->instances;
+	 style != NULL;
+	 style = style->nextInstance) {
+	IStyle_ForgetDrawn(style);
+	if (IS_SHARED(style))
+	    style->elements = style->shared->elements;
+	else
+	    style->elements = IElementLink_ChangeArray(tree, style->elements,
+		    oldCount, count, elemList, map);
+	style->neededWidth = style->neededHeight = -1;
+	Tree_InvalidateColumnWidth(tree, IStyle_TreeColumn(tree, style));
+	TreeItemColumn_InvalidateSize(tree, style->column);
+	TreeItem_InvalidateHeight(tree, style->item);
+	Tree_FreeItemDInfo(tree, style->item, NULL);
+	updateDInfo = TRUE;
     }
     if (updateDInfo)
 	Tree_DInfoChanged(tree, DINFO_REDO_RANGES);
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * IStyle_InvalidateElement --
+ *
+ *	Mark as dirty the part of an item where an element was last
+ *	drawn. This is called when the appearance of an element changed
+ *	but not its size. If the element wasn't drawn the whole
+ *	item-column is marked dirty.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	The widget will be redisplayed at idle time if the item is
+ *	onscreen.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+IStyle_InvalidateElement(
+    TreeCtrl *tree,		/* Widget info. */
+    TreeItem item,		/* Item containing the element. */
+    TreeColumn treeColumn,	/* Column containing the element. */
+    IStyle *style,		/* Instance style containing the element. */
+    IElementLink *eLink		/* The element that changed. */
+    )
+{
+    TreeRectangle *drawn;
+
+    if (style->drawn != NULL) {
+	drawn = &style->drawn[eLink - style->elements];
+	if ((drawn->width > 0) && (drawn->height > 0)) {
+	    Tree_InvalidateItemDInfoRect(tree, treeColumn, item,
+		    drawn->x, drawn->y, drawn->width, drawn->height);
+	    return;
+	}
+    }
+    Tree_InvalidateItemDInfo(tree, treeColumn, item, NULL);
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -3803,16 +4126,10 @@ Style_ElemChanged(
 				 * TreeElementType.changeProc(). */
     )
 {
-    TreeItem item;
-    TreeItemColumn column;
-    TreeColumn treeColumn;
-    Tcl_HashEntry *hPtr;
-    Tcl_HashSearch search;
     IElementLink *eLink;
-    int columnIndex;
     TreeElementArgs args;
     IStyle *style;
-    int eMask, cMask, iMask;
+    int eMask, cMask;
     int updateDInfo = FALSE;
 
     args.tree = tree;
@@ -3820,57 +4137,39 @@ Style_ElemChanged(
     args.change.flagMaster = flagM;
     args.change.flagSelf = 0;
 
-    hPtr = Tcl_FirstHashEntry(&tree->itemHash, &search);
-    while (hPtr != NULL) {
-	item = (TreeItem) Tcl_GetHashValue(hPtr);
-	treeColumn = tree->columns;
-	column = TreeItem_GetFirstColumn(tree, item);
-	columnIndex = 0;
-	iMask = 0;
-	while (column != NULL) {
-	    cMask = 0;
-	    style = (IStyle *) TreeItemColumn_GetStyle(tree, column);
-	    if ((style != NULL) && (style->master == masterStyle)) {
-		eLink = &style->elements[masterElemIndex];
-		if (eLink->elem == masterElem) {
+    for (style = masterStyle->instances;
+	 style != NULL;
+	 style = style->nextInstance) {
+	eLink = &style->elements[masterElemIndex];
+	if (eLink->elem == masterElem) {
 #ifdef CACHE_ELEM_SIZE
-		    if (csM & CS_LAYOUT)
-			eLink->neededWidth = eLink->neededHeight = -1;
+	    if (csM & CS_LAYOUT)
+		eLink->neededWidth = eLink->neededHeight = -1;
 #endif
-		    cMask |= csM;
-		}
-		/* Instance element */
-		else {
-		    args.elem = eLink->elem;
-		    eMask = (*masterElem->typePtr->changeProc)(&args);
+	    cMask = csM;
+	}
+	/* Instance element */
+	else {
+	    args.elem = eLink->elem;
+	    eMask = (*masterElem->typePtr->changeProc)(&args);
 #ifdef CACHE_ELEM_SIZE
-		    if (eMask & CS_LAYOUT)
-			eLink->neededWidth = eLink->neededHeight = -1;
+	    if (eMask & CS_LAYOUT)
+		eLink->neededWidth = eLink->neededHeight = -1;
 #endif
-		    cMask |= eMask;
-		}
-		iMask |= cMask;
-		if (cMask & CS_LAYOUT) {
-		    style->neededWidth = style->neededHeight = -1;
-		    Tree_InvalidateColumnWidth(tree, treeColumn);
-		    TreeItemColumn_InvalidateSize(tree, column);
-		}
-		else if (cMask & CS_DISPLAY) {
-		    Tree_InvalidateItemDInfo(tree, treeColumn, item, NULL);
-		}
-	    }
-	    columnIndex++;
-	    column = TreeItemColumn_GetNext(tree, column);
-	    treeColumn = TreeColumn_Next(treeColumn);
+	    cMask = eMask;
 	}
-	if (iMask & CS_LAYOUT) {
-	    TreeItem_InvalidateHeight(tree, item);
-	    Tree_FreeItemDInfo(tree, item, NULL);
+	if (cMask & CS_LAYOUT) {
+	    style->neededWidth = style->neededHeight = -1;
+	    Tree_InvalidateColumnWidth(tree, IStyle_TreeColumn(tree, style));
+	    TreeItemColumn_InvalidateSize(tree, style->column);
+	    TreeItem_InvalidateHeight(tree, style->item);
+	    Tree_FreeItemDInfo(tree, style->item, NULL);
 	    updateDInfo = TRUE;
 	}
-	else if (iMask & CS_DISPLAY) {
+	else if (cMask & CS_DISPLAY) {
+	    IStyle_InvalidateElement(tree, style->item,
+		    IStyle_TreeColumn(tree, style), style, eLink);
 	}
-	hPtr = Tcl_NextHashEntry(&search);
     }
     if (updateDInfo)
 	Tree_DInfoChanged(tree, DINFO_REDO_RANGES);
@@ -4058,6 +4357,8 @@ Style_SetImageOrText(
 	    TreeElementArgs args;
 
 	    eLink = Style_CreateElem(tree, item, column, style, masterElem, NULL);
+	    if (eLink == NULL)
+		return TCL_ERROR;
 
 	    objv[0] = *optionNameObj;
 	    objv[1] = valueObj;
@@ -4174,32 +4475,17 @@ Style_Deleted(
     )
 {
     TreeItem item;
-    TreeItemColumn column;
     TreeColumn treeColumn;
-    Tcl_HashEntry *hPtr;
-    Tcl_HashSearch search;
     IStyle *style;
     int columnIndex;
 
-    hPtr = Tcl_FirstHashEntry(&tree->itemHash, &search);
-    while (hPtr != NULL) {
-	item = (TreeItem) Tcl_GetHashValue(hPtr);
-	treeColumn = tree->columns;
-	column = TreeItem_GetFirstColumn(tree, item);
-	columnIndex = 0;
-	while (column != NULL) {
-	    style = (IStyle *) TreeItemColumn_GetStyle(tree, column);
-	    if ((style != NULL) && (style->master == masterStyle)) {
-		Tree_InvalidateColumnWidth(tree, treeColumn);
-		TreeItemColumn_ForgetStyle(tree, column);
-		TreeItem_InvalidateHeight(tree, item);
-		Tree_FreeItemDInfo(tree, item, NULL);
-	    }
-	    columnIndex++;
-	    column = TreeItemColumn_GetNext(tree, column);
-	    treeColumn = TreeColumn_Next(treeColumn);
-	}
-	hPtr = Tcl_NextHashEntry(&search);
+    /* Forgetting the style removes it from the list of instances. */
+    while ((style = masterStyle->instances) != NULL) {
+	item = style->item;
+	Tree_InvalidateColumnWidth(tree, IStyle_TreeColumn(tree, style));
+	TreeItemColumn_ForgetStyle(tree, style->column);
+	TreeItem_InvalidateHeight(tree, item);
+	Tree_FreeItemDInfo(tree, item, NULL);
     }
 
     /* Update each column's -itemstyle option */
@@ -4346,7 +4632,8 @@ Element_Deleted(
  *
  * Tree_RedrawElement --
  *
- *	A STUB export. Schedules a redraw of the given item.
+ *	A STUB export. Schedules a redraw of the part of the given item
+ *	where the element was drawn.
  *
  * Results:
  *	None.
@@ -4370,10 +4657,39 @@ Tree_RedrawElement(
 
     /* Instance element */
     else {
+	TreeItemColumn column = TreeItem_GetFirstColumn(tree, item);
+	TreeColumn treeColumn = tree->columns;
+	IStyle *style;
+	int i;
+
+	while ((column != NULL) && (treeColumn != NULL)) {
+	    style = (IStyle *) TreeItemColumn_GetStyle(tree, column);
+	    if (style != NULL) {
+		for (i = 0; i < style->master->numElements; i++) {
+		    if (style->elements[i].elem == elem) {
+			IStyle_InvalidateElement(tree, item, treeColumn, style,
+				&style->elements[i]);
+			return;
+		    }
+		}
+	    }
+	    column = TreeItemColumn_GetNext(tree, column);
+	    treeColumn = TreeColumn_Next(treeColumn);
+	}
 	Tree_InvalidateItemDInfo(tree, NULL, item, NULL);
     }
 }
 
+/* An element of the type being iterated over, see
+ * Tree_ElementIterateBegin(). */
+typedef struct IterateMatch
+{
+    IStyle *style;		/* Instance style holding the element. */
+    IElementLink *eLink;	/* The element. */
+    int index;			/* Item.index of the style's item. */
+    int columnIndex;		/* Index of the style's item-column. */
+} IterateMatch;
+
 typedef struct Iterate
 {
     TreeCtrl *tree;
@@ -4383,50 +4699,121 @@ typedef struct Iterate
     IStyle *style;
     TreeElementType *elemTypePtr;
     IElementLink *eLink;
-    Tcl_HashSearch search;
-    Tcl_HashEntry *hPtr;
+    IterateMatch *matches;	/* Every matching element, in item order. */
+    int count;			/* Number of matches[]. */
+    int current;		/* Index of the current matches[]. */
 } Iterate;
 
-static int IterateItem(Iterate *iter)
+static int
+IterateCompare(
+    CONST VOID *first_,
+    CONST VOID *second_
+    )
 {
-    int i;
+    CONST IterateMatch *first = (CONST IterateMatch *) first_;
+    CONST IterateMatch *second = (CONST IterateMatch *) second_;
 
-    while (iter->column != NULL) {
-	iter->style = (IStyle *) TreeItemColumn_GetStyle(iter->tree, iter->column);
-	if (iter->style != NULL) {
-	    for (i = 0; i < iter->style->master->numElements; i++) {
-		iter->eLink = &iter->style->elements[i];
-		if (ELEMENT_TYPE_MATCHES(iter->eLink->elem->typePtr, iter->elemTypePtr))
-		    return 1;
-	    }
-	}
-	iter->column = TreeItemColumn_GetNext(iter->tree, iter->column);
-	iter->columnIndex++;
-    }
-    return 0;
+    if (first->index != second->index)
+	return first->index - second->index;
+    return first->columnIndex - second->columnIndex;
 }
 
+static void
+IterateSet(
+    Iterate *iter
+    )
+{
+    IterateMatch *match = &iter->matches[iter->current];
+
+    iter->style = match->style;
+    iter->eLink = match->eLink;
+    iter->item = match->style->item;
+    iter->column = match->style->column;
+    iter->columnIndex = match->columnIndex;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * Tree_ElementIterateBegin --
+ *
+ *	Begin iterating over every element of a given type in every
+ *	item-column. Only the instances of master styles containing
+ *	such an element are examined, by way of each master style's
+ *	list of instances, so the cost does not depend on the number
+ *	of items that don't use the element type. The first matching
+ *	element in each item-column is visited, in item order.
+ *
+ * Results:
+ *	An iterator token, or NULL if there are no matching elements.
+ *
+ * Side effects:
+ *	Memory is allocated.
+ *
+ *----------------------------------------------------------------------
+ */
+
 TreeIterate
 Tree_ElementIterateBegin(
     TreeCtrl *tree,
     TreeElementType *elemTypePtr)
 {
     Iterate *iter;
+    Tcl_HashEntry *hPtr;
+    Tcl_HashSearch search;
+    MStyle *masterStyle;
+    IStyle *style;
+    IterateMatch *match;
+    int i, count = 0, alloc = 0;
 
     iter = (Iterate *) ckalloc(sizeof(Iterate));
     iter->tree = tree;
     iter->elemTypePtr = elemTypePtr;
-    iter->hPtr = Tcl_FirstHashEntry(&tree->itemHash, &iter->search);
-    while (iter->hPtr != NULL) {
-	iter->item = (TreeItem) Tcl_GetHashValue(iter->hPtr);
-	iter->column = TreeItem_GetFirstColumn(tree, iter->item);
-	iter->columnIndex = 0;
-	if (IterateItem(iter))
-	    return (TreeIterate) iter;
-	iter->hPtr = Tcl_NextHashEntry(&iter->search);
+    iter->matches = NULL;
+
+    hPtr = Tcl_FirstHashEntry(&tree->styleHash, &search);
+    while (hPtr != NULL) {
+	masterStyle = (MStyle *) Tcl_GetHashValue(hPtr);
+	hPtr = Tcl_NextHashEntry(&search);
+
+	/* Instance elements have the same type as their master. */
+	for (i = 0; i < masterStyle->numElements; i++) {
+	    if (ELEMENT_TYPE_MATCHES(masterStyle->elements[i].elem->typePtr,
+		    elemTypePtr))
+		break;
+	}
+	if (i == masterStyle->numElements)
+	    continue;
+
+	for (style = masterStyle->instances;
+	     style != NULL;
+	     style = style->nextInstance) {
+	    if (count == alloc) {
+		alloc = alloc ? alloc * 2 : 32;
+		iter->matches = (IterateMatch *) ckrealloc(
+		    (char *) iter->matches, alloc * sizeof(IterateMatch));
+	    }
+	    match = &iter->matches[count++];
+	    match->style = style;
+	    match->eLink = &style->elements[i];
+	    TreeItem_ToIndex(tree, style->item, &match->index, NULL);
+	    match->columnIndex = TreeItemColumn_Index(tree, style->item,
+		style->column);
+	}
     }
-    ckfree((char *) iter);
-    return NULL;
+
+    if (count == 0) {
+	ckfree((char *) iter);
+	return NULL;
+    }
+
+    /* TkTable uses this, but mentions possible lack of thread-safety. */
+    qsort((VOID *) iter->matches, (size_t) count, sizeof(IterateMatch),
+	IterateCompare);
+    iter->count = count;
+    iter->current = 0;
+    IterateSet(iter);
+    return (TreeIterate) iter;
 }
 
 TreeIterate
@@ -4435,19 +4822,11 @@ Tree_ElementIterateNext(
 {
     Iterate *iter = (Iterate *) iter_;
 
-    iter->column = TreeItemColumn_GetNext(iter->tree, iter->column);
-    iter->columnIndex++;
-    if (IterateItem(iter))
+    if (++iter->current < iter->count) {
+	IterateSet(iter);
 	return iter_;
-    iter->hPtr = Tcl_NextHashEntry(&iter->search);
-    while (iter->hPtr != NULL) {
-	iter->item = (TreeItem) Tcl_GetHashValue(iter->hPtr);
-	iter->column = TreeItem_GetFirstColumn(iter->tree, iter->item);
-	iter->columnIndex = 0;
-	if (IterateItem(iter))
-	    return iter_;
-	iter->hPtr = Tcl_NextHashEntry(&iter->search);
     }
+    ckfree((char *) iter->matches);
     ckfree((char *) iter);
     return NULL;
 }
@@ -4519,11 +4898,20 @@ Tree_ElementChangedItself(
 	Tree_DInfoChanged(tree, DINFO_REDO_RANGES);
     }
     else if (csM & CS_DISPLAY) {
+	IStyle *style = (IStyle *) TreeItemColumn_GetStyle(tree, column);
+	IElementLink *eLink;
 	int columnIndex;
 
 	columnIndex = TreeItemColumn_Index(tree, item, column);
-	Tree_InvalidateItemDInfo(tree, Tree_FindColumn(tree, columnIndex),
-		item, NULL);
+	eLink = (style == NULL) ? NULL :
+		IStyle_FindElem(tree, style, elem, NULL);
+	if (eLink != NULL) {
+	    IStyle_InvalidateElement(tree, item,
+		    Tree_FindColumn(tree, columnIndex), style, eLink);
+	} else {
+	    Tree_InvalidateItemDInfo(tree, Tree_FindColumn(tree, columnIndex),
+		    item, NULL);
+	}
     }
 }
 
@@ -4543,8 +4931,10 @@ void Tree_ElementIterateChanged(TreeIterate iter_, int mask)
 	Tree_FreeItemDInfo(iter->tree, iter->item, NULL);
 	Tree_DInfoChanged(iter->tree, DINFO_REDO_RANGES);
     }
-    if (mask & CS_DISPLAY)
-	Tree_InvalidateItemDInfo(iter->tree, NULL, iter->item, NULL);
+    else if (mask & CS_DISPLAY)
+	IStyle_InvalidateElement(iter->tree, iter->item,
+		Tree_FindColumn(iter->tree, iter->columnIndex), iter->style,
+		iter->eLink);
 }
 
 TreeElement Tree_ElementIterateGet(TreeIterate iter_)
@@ -4676,7 +5066,9 @@ TreeStyle_ElementCget(
  *	A standard Tcl result.
  *
  * Side effects:
- *	See the user documentation.
+ *	See the user documentation. If only the appearance of the element
+ *	changed, the part of the item where it was drawn is marked dirty
+ *	here and the caller needn't do anything about CS_DISPLAY.
  *
  *----------------------------------------------------------------------
  */
@@ -4766,11 +5158,20 @@ TreeStyle_ElementConfigure(
 	args.change.flagMaster = 0;
 	(*eMask) |= (*elem->typePtr->changeProc)(&args);
 
-	if (!isNew && ((*eMask) & CS_LAYOUT)) {
+	/* A new element always changes the layout, which the caller
+	 * handles by redrawing the whole item-column. */
+	if ((*eMask) & CS_LAYOUT) {
+	    if (!isNew) {
 #ifdef CACHE_ELEM_SIZE
-	    eLink->neededWidth = eLink->neededHeight = -1;
+		eLink->neededWidth = eLink->neededHeight = -1;
 #endif
-	    style->neededWidth = style->neededHeight = -1;
+		style->neededWidth = style->neededHeight = -1;
+	    }
+	} else if ((*eMask) & CS_DISPLAY) {
+	    int index = TreeItemColumn_Index(tree, item, column);
+
+	    IStyle_InvalidateElement(tree, item, Tree_FindColumn(tree, index),
+		    style, eLink);
 	}
     }
     return TCL_OK;
@@ -6077,6 +6478,42 @@ Tree_ButtonHeight(
     return tree->buttonSize;
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * HitCache_Find --
+ *
+ *	Hit-test the element rectangles saved by TreeStyle_Identify.
+ *
+ * Results:
+ *	The name of the top-most element containing the given point,
+ *	or NULL.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static char *
+HitCache_Find(
+    StyleHitCache *hits,	/* Element rectangles. */
+    int x, int y		/* Style coords to hit-test with. */
+    )
+{
+    int i;
+
+    for (i = hits->count - 1; i >= 0; i--) {
+	StyleHitRect *rect = &hits->rects[i];
+
+	if ((x >= rect->x) && (x < rect->x + rect->width) &&
+	    (y >= rect->y) && (y < rect->y + rect->height)) {
+	    return (char *) rect->name;
+	}
+    }
+    return NULL;
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -6088,7 +6525,9 @@ Tree_ButtonHeight(
  *	The name of the element containing the given point, or NULL.
  *
  * Side effects:
- *	None.
+ *	If a cache is given and it doesn't hold the layout for the
+ *	given arguments, it is refilled with the element rectangles
+ *	and memory may be allocated.
  *
  *----------------------------------------------------------------------
  */
@@ -6097,7 +6536,9 @@ char *
 TreeStyle_Identify(
     StyleDrawArgs *drawArgs,	/* Various args. */
     int x,			/* Window x-coord to hit-test against. */
-    int y			/* Window y-coord to hit-test against. */
+    int y,			/* Window y-coord to hit-test against. */
+    StyleHitCache *hits		/* Element rectangles from a previous call,
+				 * or NULL. */
     )
 {
     TreeCtrl *tree = drawArgs->tree;
@@ -6108,6 +6549,15 @@ TreeStyle_Identify(
     int i, minWidth, minHeight;
     struct Layout staticLayouts[STATIC_SIZE], *layouts = staticLayouts;
 
+    if ((hits != NULL) && (hits->style == drawArgs->style) &&
+	    (hits->state == state) &&
+	    (hits->indent == drawArgs->indent) &&
+	    (hits->width == drawArgs->width) &&
+	    (hits->height == drawArgs->height) &&
+	    (hits->justify == drawArgs->justify)) {
+	return HitCache_Find(hits, x - drawArgs->x, y);
+    }
+
     Style_CheckNeededSize(tree, style, state);
 #ifdef CACHE_STYLE_SIZE
     minWidth = style->minWidth;
@@ -6116,17 +6566,51 @@ TreeStyle_Identify(
     Style_MinSize(tree, style, state, &minWidth, &minHeight);
 #endif
 
+    if (hits != NULL) {
+	hits->style = drawArgs->style;
+	hits->state = state;
+	hits->indent = drawArgs->indent;
+	hits->width = drawArgs->width;
+	hits->height = drawArgs->height;
+	hits->justify = drawArgs->justify;
+    }
+
     if (drawArgs->width < minWidth + drawArgs->indent)
 	drawArgs->width = minWidth + drawArgs->indent;
     if (drawArgs->height < minHeight)
 	drawArgs->height = minHeight;
 
-    x -= drawArgs->x;
-
     STATIC_ALLOC(layouts, struct Layout, masterStyle->numElements);
 
     Style_DoLayout(drawArgs, layouts, FALSE, __FILE__, __LINE__);
 
+    if (hits != NULL) {
+	if (hits->alloc < masterStyle->numElements) {
+	    hits->rects = (StyleHitRect *) ckrealloc((char *) hits->rects,
+		    sizeof(StyleHitRect) * masterStyle->numElements);
+	    hits->alloc = masterStyle->numElements;
+	}
+	hits->count = 0;
+	for (i = 0; i < masterStyle->numElements; i++) {
+	    struct Layout *layout = &layouts[i];
+	    StyleHitRect *rect;
+
+	    if (IS_HIDDEN(layout))
+		continue;
+
+	    rect = &hits->rects[hits->count++];
+	    rect->name = layout->eLink->elem->name;
+	    rect->x = layout->x + layout->ePadX[PAD_TOP_LEFT];
+	    rect->y = layout->y + layout->ePadY[PAD_TOP_LEFT];
+	    rect->width = layout->iWidth;
+	    rect->height = layout->iHeight;
+	}
+	STATIC_FREE(layouts, struct Layout, masterStyle->numElements);
+	return HitCache_Find(hits, x - drawArgs->x, y);
+    }
+
+    x -= drawArgs->x;
+
     for (i = style->master->numElements - 1; i >= 0; i--) {
 	struct Layout *layout = &layouts[i];
 
@@ -6320,6 +6804,21 @@ TreeStyle_Remap(
 	}
     }
 
+    /* A shared array has no instance elements to carry over, so use
+     * one of the new style's shared arrays. */
+    if (IS_SHARED(styleFrom)) {
+	int state = styleFrom->shared->state;
+
+	IStyle_UnshareElements(tree, styleFrom);
+	MStyle_RemoveInstance(styleFrom->master, styleFrom);
+	styleFrom->master = styleTo;
+	MStyle_AddInstance(styleTo, styleFrom);
+	IStyle_ShareElements(tree, styleFrom, state);
+	styleFrom->neededWidth = styleFrom->neededHeight = -1;
+	IStyle_ForgetDrawn(styleFrom);
+	goto done;
+    }
+
     for (i = 0; i < styleFromNumElements; i++) {
 	eLink = &styleFrom->elements[i];
 	indexTo = map[i];
@@ -6367,8 +6866,11 @@ TreeStyle_Remap(
 	if (indexTo != -1)
 	    styleFrom->elements[indexTo].elem = elemMap[i];
     }
+    MStyle_RemoveInstance(styleFrom->master, styleFrom);
     styleFrom->master = styleTo;
+    MStyle_AddInstance(styleTo, styleFrom);
     styleFrom->neededWidth = styleFrom->neededHeight = -1;
+    IStyle_ForgetDrawn(styleFrom);
 
 done:
     STATIC_FREE(map, int, styleFromNumElements);
@@ -6478,6 +6980,58 @@ TreeStyle_ValidateElements(
 
 #endif /* 0 */
 
+#ifdef TREECTRL_BENCH
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TreeStyle_BenchLayoutH --
+ *
+ *	Call Style_DoLayoutH() repeatedly for the [treectrl::bench]
+ *	command.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+TreeStyle_BenchLayoutH(
+    StyleDrawArgs *drawArgs,	/* Various args. */
+    int iterations		/* Number of times to lay out. */
+    )
+{
+    IStyle *style = (IStyle *) drawArgs->style;
+    MStyle *master = style->master;
+    struct Layout staticLayouts[STATIC_SIZE], *layouts = staticLayouts;
+    int i, minWidth, minHeight;
+
+    /* Same as TreeStyle_GetElemRects */
+    (void) TreeStyle_NeededWidth(drawArgs->tree, (TreeStyle) style,
+	    drawArgs->state);
+#ifdef CACHE_STYLE_SIZE
+    minWidth = style->minWidth;
+    minHeight = style->minHeight;
+#else
+    Style_MinSize(drawArgs->tree, style, drawArgs->state, &minWidth, &minHeight);
+#endif
+    if (drawArgs->width < minWidth + drawArgs->indent)
+	drawArgs->width = minWidth + drawArgs->indent;
+    if (drawArgs->height < minHeight)
+	drawArgs->height = minHeight;
+
+    STATIC_ALLOC(layouts, struct Layout, master->numElements);
+    for (i = 0; i < iterations; i++)
+	Style_DoLayoutH(drawArgs, layouts);
+    STATIC_FREE(layouts, struct Layout, master->numElements);
+}
+
+#endif /* TREECTRL_BENCH */
+
 /*
  *----------------------------------------------------------------------
  *
@@ -6528,6 +7082,7 @@ TreeStyle_GetElemRects(
 	}
     }
 
+    Style_CheckNeededSize(drawArgs->tree, style, drawArgs->state);
 #ifdef CACHE_STYLE_SIZE
     minWidth = style->minWidth;
     minHeight = style->minHeight;
@@ -6669,7 +7224,8 @@ TreeStyle_ChangeState(
 
 	if (eMask) {
 #ifdef CACHE_ELEM_SIZE
-	    if (eMask & CS_LAYOUT)
+	    /* A shared array of elements is only used in one state. */
+	    if ((eMask & CS_LAYOUT) && !IS_SHARED(style))
 		eLink2->neededWidth = eLink2->neededHeight = -1;
 #endif
 	    mask |= eMask;
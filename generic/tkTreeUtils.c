@@ -14,6 +14,18 @@
 #include "tkWinInt.h"
 #endif
 
+/* MIT-SHM for XGetImage(), see Tree_XGetImage() */
+#ifdef TREECTRL_XSHM
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <X11/extensions/XShm.h>
+
+/* Areas with fewer pixels than this are read with plain XGetImage().
+ * Creating and attaching a segment costs extra round trips that only
+ * pay off for larger images. */
+#define XSHM_MIN_PIXELS (128 * 128)
+#endif
+
 /* OffsetRgn() on Mac */
 #if defined(MAC_OSX_TK)
 #include <Carbon/Carbon.h>
@@ -190,6 +202,11 @@ DStringAppendf(
     Tcl_DStringAppend(dString, buf, -1);
 }
 
+typedef struct AsciiWidths AsciiWidths;
+static int TextIsAscii(CONST char *text, int numBytes);
+static AsciiWidths *TextCache_AsciiWidths(TreeCtrl *tree, Tk_Font tkfont);
+static int AsciiWidths_Char(AsciiWidths *aw, Tk_Font tkfont, int ch);
+
 /*
  *----------------------------------------------------------------------
  *
@@ -212,13 +229,15 @@ DStringAppendf(
  *	plus ellipsis. The substring has a minimum of one character.
  *
  * Side effects:
- *	None.
+ *	The widths of ASCII characters in the font may be cached.
  *
  *----------------------------------------------------------------------
  */
 
 int
 Tree_Ellipsis(
+    TreeCtrl *tree,		/* Widget info, or NULL to always ask the
+				 * font. */
     Tk_Font tkfont,		/* The font used to display the string. */
     char *string,		/* UTF-8 string, need not be NULL-terminated. */
     int numBytes,		/* Number of bytes to consider. */
@@ -232,10 +251,49 @@ Tree_Ellipsis(
     )
 {
     char staticStr[256], *tmpStr = staticStr;
+    int staticEnds[256], *charEnds = staticEnds;
     int pixels, pixelsTest, bytesThatFit, bytesTest;
     int ellipsisNumBytes = strlen(ellipsis);
     int bytesInFirstCh;
+    int numChars, low, high, mid, best;
+    CONST char *p;
     Tcl_UniChar uniCh;
+    AsciiWidths *aw;
+
+    /* Add up the widths of the characters without calling the font
+     * code when the font allows it. */
+    if ((tree != NULL) && TextIsAscii(string, numBytes) &&
+	    TextIsAscii(ellipsis, ellipsisNumBytes) &&
+	    ((aw = TextCache_AsciiWidths(tree, tkfont)) != NULL)) {
+	int ellipsisPixels = 0, fit = 0, fitPixels = 0;
+
+	for (bytesTest = 0; bytesTest < ellipsisNumBytes; bytesTest++)
+	    ellipsisPixels += AsciiWidths_Char(aw, tkfont, ellipsis[bytesTest]);
+	pixels = 0;
+	for (bytesTest = 0; bytesTest < numBytes; bytesTest++) {
+	    pixels += AsciiWidths_Char(aw, tkfont, string[bytesTest]);
+	    if ((bytesTest + 1 < numBytes || force) &&
+		    (pixels + ellipsisPixels <= *maxPixels)) {
+		fit = bytesTest + 1;
+		fitPixels = pixels + ellipsisPixels;
+	    }
+	}
+
+	/* The whole string fits. No ellipsis needed (unless forced) */
+	if ((pixels <= *maxPixels) && !force) {
+	    (*maxPixels) = pixels;
+	    return numBytes;
+	}
+
+	/* At least one character is returned. */
+	if (fit == 0) {
+	    fit = 1;
+	    fitPixels = AsciiWidths_Char(aw, tkfont, string[0]) +
+		ellipsisPixels;
+	}
+	(*maxPixels) = fitPixels;
+	return fit;
+    }
 
     bytesThatFit = Tk_MeasureChars(tkfont, string, numBytes, *maxPixels, 0,
 	&pixels);
@@ -251,27 +309,53 @@ Tree_Ellipsis(
 	goto singleChar;
     }
 
-    /* Strip off one character at a time, adding ellipsis, until it fits */
+    /* Find the longest substring that fits with the ellipsis added.
+     * The width only grows as characters are added, so do a binary
+     * search on the character boundaries instead of stripping off one
+     * character at a time. */
     if (force)
 	bytesTest = bytesThatFit;
     else
 	bytesTest = Tcl_UtfPrev(string + bytesThatFit, string) - string;
     if (bytesTest + ellipsisNumBytes > sizeof(staticStr))
 	tmpStr = ckalloc(bytesTest + ellipsisNumBytes);
+    if (bytesTest > sizeof(staticEnds) / sizeof(staticEnds[0]))
+	charEnds = (int *) ckalloc(sizeof(int) * bytesTest);
+    numChars = 0;
+    for (p = string; p < string + bytesTest; p = Tcl_UtfNext(p))
+	charEnds[numChars++] = Tcl_UtfNext(p) - string;
     memcpy(tmpStr, string, bytesTest);
-    while (bytesTest > 0) {
+    best = -1;
+    low = 0, high = numChars - 1;
+    while (low <= high) {
+	mid = (low + high) / 2;
+	bytesTest = charEnds[mid];
 	memcpy(tmpStr + bytesTest, ellipsis, ellipsisNumBytes);
 	numBytes = Tk_MeasureChars(tkfont, tmpStr,
 	    bytesTest + ellipsisNumBytes,
 	    *maxPixels, 0, &pixelsTest);
+	/* Put back what the ellipsis overwrote. */
+	memcpy(tmpStr + bytesTest, string + bytesTest,
+	    MIN(ellipsisNumBytes, charEnds[numChars - 1] - bytesTest));
 	if (numBytes == bytesTest + ellipsisNumBytes) {
-	    (*maxPixels) = pixelsTest;
-	    if (tmpStr != staticStr)
-		ckfree(tmpStr);
-	    return bytesTest;
+	    best = mid;
+	    pixels = pixelsTest;
+	    low = mid + 1;
+	} else {
+	    high = mid - 1;
 	}
-	bytesTest = Tcl_UtfPrev(string + bytesTest, string) - string;
     }
+    if (best != -1) {
+	bytesThatFit = charEnds[best];
+	(*maxPixels) = pixels;
+	if (tmpStr != staticStr)
+	    ckfree(tmpStr);
+	if (charEnds != staticEnds)
+	    ckfree((char *) charEnds);
+	return bytesThatFit;
+    }
+    if (charEnds != staticEnds)
+	ckfree((char *) charEnds);
 
     singleChar:
     /* No single char + ellipsis fits. Return the number of bytes for
@@ -1360,19 +1444,217 @@ Tree_DrawBitmap(
 #define TK_PHOTOPUTZOOMEDBLOCK	Tk_PhotoPutZoomedBlock
 #endif
 
+#ifdef TREECTRL_XSHM
+
 /*
  *----------------------------------------------------------------------
  *
- * Tree_XImage2Photo --
+ * ShmErrorProc --
  *
- *	Copy pixels from an XImage to a Tk photo image.
+ *	Error handler installed while attaching a shared memory segment
+ *	to the X server. A remote X server can't attach the segment.
+ *
+ * Results:
+ *	Zero, meaning the error was handled.
+ *
+ * Side effects:
+ *	The integer pointed to by clientData is set to 1.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+ShmErrorProc(
+    ClientData clientData,	/* Pointer to error flag. */
+    XErrorEvent *errEventPtr	/* Not used. */
+    )
+{
+    *((int *) clientData) = 1;
+    return 0;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ShmGetImage --
+ *
+ *	Read pixels from a drawable into an XImage whose data lives in a
+ *	shared memory segment. This avoids streaming the pixels through
+ *	the X protocol connection.
+ *
+ * Results:
+ *	A new XImage, or NULL if the MIT-SHM extension is not usable.
+ *
+ * Side effects:
+ *	A shared memory segment is allocated.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static XImage *
+ShmGetImage(
+    Tk_Window tkwin,		/* Window with the visual and depth of
+				 * the drawable. */
+    Drawable drawable,		/* Where to get the pixels. */
+    int x, int y,		/* Top-left corner in the drawable. */
+    int width, int height	/* Size of the area. */
+    )
+{
+    Display *display = Tk_Display(tkwin);
+    XShmSegmentInfo *shmInfo;
+    XImage *ximage;
+    Tk_ErrorHandler handler;
+    int failed = 0;
+
+    if (!XShmQueryExtension(display))
+	return NULL;
+
+    shmInfo = (XShmSegmentInfo *) ckalloc(sizeof(XShmSegmentInfo));
+    ximage = XShmCreateImage(display, Tk_Visual(tkwin), Tk_Depth(tkwin),
+	    ZPixmap, NULL, shmInfo, width, height);
+    if (ximage == NULL) {
+	ckfree((char *) shmInfo);
+	return NULL;
+    }
+    shmInfo->shmid = shmget(IPC_PRIVATE, ximage->bytes_per_line * height,
+	    IPC_CREAT | 0600);
+    if (shmInfo->shmid == -1) {
+	XDestroyImage(ximage);
+	ckfree((char *) shmInfo);
+	return NULL;
+    }
+    shmInfo->shmaddr = ximage->data = (char *) shmat(shmInfo->shmid, NULL, 0);
+    shmInfo->readOnly = False;
+
+    /* Mark the segment for removal now; it goes away after the last
+     * detach, even if we crash. */
+    if (shmInfo->shmaddr != (char *) -1)
+	shmctl(shmInfo->shmid, IPC_RMID, NULL);
+    else
+	failed = 1;
+
+    if (!failed) {
+	handler = Tk_CreateErrorHandler(display, -1, -1, -1, ShmErrorProc,
+		(ClientData) &failed);
+	XShmAttach(display, shmInfo);
+	XSync(display, False);
+	if (!failed) {
+	    XShmGetImage(display, drawable, ximage, x, y, AllPlanes);
+	    XSync(display, False);
+	}
+	Tk_DeleteErrorHandler(handler);
+	if (failed)
+	    XShmDetach(display, shmInfo);
+    }
+
+    if (failed) {
+	if (shmInfo->shmaddr != (char *) -1)
+	    shmdt(shmInfo->shmaddr);
+	else
+	    shmctl(shmInfo->shmid, IPC_RMID, NULL);
+	XDestroyImage(ximage);
+	ckfree((char *) shmInfo);
+	return NULL;
+    }
+
+    /* XShmCreateImage() put shmInfo in ximage->obdata. */
+    return ximage;
+}
+
+#endif /* TREECTRL_XSHM */
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * Tree_XGetImage --
+ *
+ *	Read pixels from a drawable into a new XImage. When built with
+ *	TREECTRL_XSHM the pixels of a large enough area are transferred
+ *	through a shared memory segment if the X server supports the
+ *	MIT-SHM extension and is on the same machine. Otherwise
+ *	XGetImage() is used.
+ *
+ * Results:
+ *	A new XImage to be freed with Tree_XDestroyImage(), or NULL.
+ *
+ * Side effects:
+ *	Memory is allocated.
+ *
+ *----------------------------------------------------------------------
+ */
+
+XImage *
+Tree_XGetImage(
+    Tk_Window tkwin,		/* Window with the visual and depth of
+				 * the drawable. */
+    Drawable drawable,		/* Where to get the pixels. */
+    int x, int y,		/* Top-left corner in the drawable. */
+    int width, int height	/* Size of the area. */
+    )
+{
+#ifdef TREECTRL_XSHM
+    XImage *ximage;
+
+    if (width * height >= XSHM_MIN_PIXELS) {
+	ximage = ShmGetImage(tkwin, drawable, x, y, width, height);
+	if (ximage != NULL)
+	    return ximage;
+    }
+#endif
+    return XGetImage(Tk_Display(tkwin), drawable, x, y,
+	    (unsigned int) width, (unsigned int) height, AllPlanes, ZPixmap);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * Tree_XDestroyImage --
+ *
+ *	Free an XImage returned by Tree_XGetImage().
  *
  * Results:
  *	None.
  *
  * Side effects:
- *	The given photo image is blanked and all the pixels from the
- *	XImage are put into the photo image.
+ *	Memory is freed. A shared memory segment may be detached.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+Tree_XDestroyImage(
+    Display *display,		/* Display the image was read from. */
+    XImage *ximage		/* Image to free. */
+    )
+{
+#ifdef TREECTRL_XSHM
+    XShmSegmentInfo *shmInfo = (XShmSegmentInfo *) ximage->obdata;
+
+    if (shmInfo != NULL) {
+	XShmDetach(display, shmInfo);
+	XDestroyImage(ximage);
+	shmdt(shmInfo->shmaddr);
+	ckfree((char *) shmInfo);
+	return;
+    }
+#endif
+    XDestroyImage(ximage);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * Tree_XImage2PhotoAt --
+ *
+ *	Copy pixels from an XImage to part of a Tk photo image.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	All the pixels from the XImage are put into the photo image
+ *	with their top-left corner at the given position. The photo
+ *	image grows if needed.
  *
  *----------------------------------------------------------------------
  */
@@ -1380,10 +1662,11 @@ Tree_DrawBitmap(
 #if defined(WIN32) || defined(MAC_TCL) || defined(MAC_OSX_TK)
 
 void
-Tree_XImage2Photo(
+Tree_XImage2PhotoAt(
     Tcl_Interp *interp,		/* Current interpreter. */
     Tk_PhotoHandle photoH,	/* Existing photo image. */
     XImage *ximage,		/* XImage to copy pixels from. */
+    int destX, int destY,	/* Where to put the pixels in the photo. */
     int alpha			/* Desired transparency of photo image.*/
     )
 {
@@ -1394,8 +1677,6 @@ Tree_XImage2Photo(
     unsigned long red_shift, green_shift, blue_shift;
 #endif
 
-    Tk_PhotoBlank(photoH);
-
     /* See TkPoscriptImage */
 
 #if defined(MAC_TCL) || defined(MAC_OSX_TK)
@@ -1443,7 +1724,7 @@ Tree_XImage2Photo(
 	}
     }
 
-    TK_PHOTOPUTBLOCK(interp, photoH, &photoBlock, 0, 0, w, h,
+    TK_PHOTOPUTBLOCK(interp, photoH, &photoBlock, destX, destY, w, h,
 	    TK_PHOTO_COMPOSITE_SET);
 
     Tcl_Free((char *) pixelPtr);
@@ -1452,10 +1733,11 @@ Tree_XImage2Photo(
 #else /* not X11 */
 
 void
-Tree_XImage2Photo(
+Tree_XImage2PhotoAt(
     Tcl_Interp *interp,		/* Current interpreter. */
     Tk_PhotoHandle photoH,	/* Existing photo image. */
     XImage *ximage,		/* XImage to copy pixels from. */
+    int destX, int destY,	/* Where to put the pixels in the photo. */
     int alpha			/* Desired transparency of photo image.*/
     )
 {
@@ -1467,11 +1749,10 @@ Tree_XImage2Photo(
     int x, y, w = ximage->width, h = ximage->height;
     int i, ncolors;
     XColor *xcolors;
+    unsigned char *red, *green, *blue, *dst;
     unsigned long red_shift, green_shift, blue_shift;
     int separated = 0;
 
-    Tk_PhotoBlank(photoH);
-
     /* See TkPoscriptImage */
 
     ncolors = visual->map_entries;
@@ -1501,6 +1782,17 @@ Tree_XImage2Photo(
 
     XQueryColors(display, Tk_Colormap(tkwin), xcolors, ncolors);
 
+    /* Convert the colormap to 8-bit components once instead of once
+     * per pixel. */
+    red = (unsigned char *) ckalloc(ncolors * 3);
+    green = red + ncolors;
+    blue = green + ncolors;
+    for (i = 0; i < ncolors; i++) {
+	red[i] = Tree_Color8(xcolors[i].red);
+	green[i] = Tree_Color8(xcolors[i].green);
+	blue[i] = Tree_Color8(xcolors[i].blue);
+    }
+
     pixelPtr = (unsigned char *) Tcl_Alloc(ximage->width * ximage->height * 4);
     photoBlock.pixelPtr  = pixelPtr;
     photoBlock.width     = ximage->width;
@@ -1513,39 +1805,64 @@ Tree_XImage2Photo(
     photoBlock.offset[3] = 3;
 
     for (y = 0; y < ximage->height; y++) {
+	dst = pixelPtr + y * photoBlock.pitch;
 	for (x = 0; x < ximage->width; x++) {
-	    int r, g, b;
 	    unsigned long pixel;
 
 	    pixel = XGetPixel(ximage, x, y);
 	    if (separated) {
-		r = (pixel & visual->red_mask) >> red_shift;
-		g = (pixel & visual->green_mask) >> green_shift;
-		b = (pixel & visual->blue_mask) >> blue_shift;
-		r = ((double) xcolors[r].red / USHRT_MAX) * 255;
-		g = ((double) xcolors[g].green / USHRT_MAX) * 255;
-		b = ((double) xcolors[b].blue / USHRT_MAX) * 255;
+		dst[0] = red[(pixel & visual->red_mask) >> red_shift];
+		dst[1] = green[(pixel & visual->green_mask) >> green_shift];
+		dst[2] = blue[(pixel & visual->blue_mask) >> blue_shift];
 	    } else {
-		r = ((double) xcolors[pixel].red / USHRT_MAX) * 255;
-		g = ((double) xcolors[pixel].green / USHRT_MAX) * 255;
-		b = ((double) xcolors[pixel].blue / USHRT_MAX) * 255;
+		dst[0] = red[pixel];
+		dst[1] = green[pixel];
+		dst[2] = blue[pixel];
 	    }
-	    pixelPtr[y * photoBlock.pitch + x * 4 + 0] = r;
-	    pixelPtr[y * photoBlock.pitch + x * 4 + 1] = g;
-	    pixelPtr[y * photoBlock.pitch + x * 4 + 2] = b;
-	    pixelPtr[y * photoBlock.pitch + x * 4 + 3] = alpha;
+	    dst[3] = alpha;
+	    dst += 4;
 	}
     }
 
-    TK_PHOTOPUTBLOCK(interp, photoH, &photoBlock, 0, 0, w, h,
+    TK_PHOTOPUTBLOCK(interp, photoH, &photoBlock, destX, destY, w, h,
 	    TK_PHOTO_COMPOSITE_SET);
 
     Tcl_Free((char *) pixelPtr);
+    ckfree((char *) red);
     ckfree((char *) xcolors);
 }
 
 #endif /* X11 */
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * Tree_XImage2Photo --
+ *
+ *	Copy pixels from an XImage to a Tk photo image.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	The given photo image is blanked and all the pixels from the
+ *	XImage are put into the photo image.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+Tree_XImage2Photo(
+    Tcl_Interp *interp,		/* Current interpreter. */
+    Tk_PhotoHandle photoH,	/* Existing photo image. */
+    XImage *ximage,		/* XImage to copy pixels from. */
+    int alpha			/* Desired transparency of photo image.*/
+    )
+{
+    Tk_PhotoBlank(photoH);
+    Tree_XImage2PhotoAt(interp, photoH, ximage, 0, 0, alpha);
+}
+
 /*
  * Replacement for Tk_TextLayout stuff. Allows the caller to break lines
  * on character boundaries (as well as word boundaries). Allows the caller
@@ -1594,6 +1911,8 @@ typedef struct LayoutInfo
     int numChunks;		/* Number of chunks actually used in
 				 * * following array. */
     int totalWidth;
+    struct LayoutWords *words;	/* Word widths kept for TextLayout_Reflow,
+				 * * or NULL. */
 #define TEXTLAYOUT_ALLOCHAX
 #ifdef TEXTLAYOUT_ALLOCHAX
     int maxChunks;
@@ -1610,6 +1929,264 @@ TCL_DECLARE_MUTEX(textLayoutMutex)
 static LayoutInfo *freeLayoutInfo = NULL;
 #endif
 
+/*
+ * A LayoutRun is a sequence of non-space characters or space characters
+ * in the string of a TextLayout, or a single tab or newline character.
+ */
+
+typedef struct LayoutRun
+{
+    int end;			/* Byte offset just past the last character
+				 * * of this run. */
+    int x;			/* Width in pixels from the start of the
+				 * * string to the end of this run. */
+    int space;			/* TRUE if this run is whitespace. */
+} LayoutRun;
+
+/*
+ * The widths of the words in a string, measured in a single font. These
+ * are kept by a TextLayout so that the string can be reflowed to a new
+ * width without measuring it again.
+ */
+
+typedef struct LayoutWords
+{
+    Tk_Font tkfont;		/* The font the runs were measured in. */
+    char *string;		/* Copy of the measured string. */
+    int numBytes;		/* Length of string. */
+    int measured;		/* Number of bytes of string divided into
+				 * * runs so far. */
+    int numRuns;		/* Number of runs in following array. */
+    int maxRuns;		/* Size of following array. */
+    LayoutRun *runs;		/* Array of runs. */
+} LayoutWords;
+
+static LayoutWords *
+LayoutWords_New(
+    Tk_Font tkfont,
+    CONST char *string,
+    int numBytes
+    )
+{
+    LayoutWords *wordsPtr;
+
+    wordsPtr = (LayoutWords *) ckalloc(sizeof(LayoutWords));
+    wordsPtr->tkfont = tkfont;
+    wordsPtr->string = ckalloc(numBytes + 1);
+    memcpy(wordsPtr->string, string, numBytes);
+    wordsPtr->string[numBytes] = '\0';
+    wordsPtr->numBytes = numBytes;
+    wordsPtr->measured = 0;
+    wordsPtr->numRuns = 0;
+    wordsPtr->maxRuns = 0;
+    wordsPtr->runs = NULL;
+    return wordsPtr;
+}
+
+static void
+LayoutWords_Free(
+    LayoutWords *wordsPtr
+    )
+{
+    if (wordsPtr->runs != NULL)
+	ckfree((char *) wordsPtr->runs);
+    ckfree(wordsPtr->string);
+    ckfree((char *) wordsPtr);
+}
+
+/* 0 for a non-space character, 1 for a space, 2 for a tab or newline.
+ * Spaces are what Tk_MeasureChars() breaks lines at, including non-ASCII
+ * ones such as U+3000. */
+#define RUN_CLASS(ch) \
+    (((ch) == '\t' || (ch) == '\n' || (ch) == '\r') ? 2 : \
+    (Tcl_UniCharIsSpace(ch) ? 1 : 0))
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * LayoutWords_Fill --
+ *
+ *	Divide the string into runs and measure them until the run
+ *	containing the given byte offset has been measured.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Memory may be allocated.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+LayoutWords_Fill(
+    LayoutWords *wordsPtr,
+    int offset
+    )
+{
+    CONST char *string = wordsPtr->string;
+    LayoutRun *runPtr;
+    Tcl_UniChar ch;
+    int start, end, len, runClass, width, x = 0;
+
+    while ((wordsPtr->measured <= offset) &&
+	    (wordsPtr->measured < wordsPtr->numBytes)) {
+	start = end = wordsPtr->measured;
+	end += Tcl_UtfToUniChar(string + end, &ch);
+	runClass = RUN_CLASS(ch);
+	if (runClass != 2) {
+	    while (end < wordsPtr->numBytes) {
+		len = Tcl_UtfToUniChar(string + end, &ch);
+		if (RUN_CLASS(ch) != runClass)
+		    break;
+		end += len;
+	    }
+	}
+	(void) Tk_MeasureChars(wordsPtr->tkfont, string + start, end - start,
+	    -1, 0, &width);
+	if (wordsPtr->numRuns == wordsPtr->maxRuns) {
+	    if (wordsPtr->runs == NULL) {
+		wordsPtr->maxRuns = 16;
+		wordsPtr->runs = (LayoutRun *) ckalloc(sizeof(LayoutRun) *
+		    wordsPtr->maxRuns);
+	    } else {
+		wordsPtr->maxRuns *= 2;
+		wordsPtr->runs = (LayoutRun *) ckrealloc(
+		    (char *) wordsPtr->runs,
+		    sizeof(LayoutRun) * wordsPtr->maxRuns);
+	    }
+	}
+	if (wordsPtr->numRuns > 0)
+	    x = wordsPtr->runs[wordsPtr->numRuns - 1].x;
+	runPtr = &wordsPtr->runs[wordsPtr->numRuns++];
+	runPtr->end = end;
+	runPtr->x = x + width;
+	runPtr->space = (runClass != 0);
+	wordsPtr->measured = end;
+    }
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * LayoutWords_RunAt --
+ *
+ *	Find the run that starts at the given byte offset.
+ *
+ * Results:
+ *	Index of the run, or -1 if the offset is inside a run.
+ *
+ * Side effects:
+ *	More of the string may be measured.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+LayoutWords_RunAt(
+    LayoutWords *wordsPtr,
+    int offset
+    )
+{
+    int lo = 0, hi, mid;
+
+    LayoutWords_Fill(wordsPtr, offset);
+    if (offset == 0)
+	return (wordsPtr->numRuns > 0) ? 0 : -1;
+    hi = wordsPtr->numRuns - 1;
+    while (lo <= hi) {
+	mid = (lo + hi) / 2;
+	if (wordsPtr->runs[mid].end == offset)
+	    return (mid + 1 < wordsPtr->numRuns) ? mid + 1 : -1;
+	if (wordsPtr->runs[mid].end < offset)
+	    lo = mid + 1;
+	else
+	    hi = mid - 1;
+    }
+    return -1;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * LayoutMeasure --
+ *
+ *	Same as Tk_MeasureChars(), but uses the word widths in a
+ *	LayoutWords if possible instead of measuring the text again.
+ *	The widths of runs are assumed to add up to the width of the
+ *	text containing them. Breaking a line in the middle of a word
+ *	is left to Tk_MeasureChars().
+ *
+ * Results:
+ *	The number of bytes that fit in maxLength pixels. *lengthPtr
+ *	is filled with the width of those bytes.
+ *
+ * Side effects:
+ *	More of the string may be measured.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+LayoutMeasure(
+    LayoutWords *wordsPtr,	/* Measured runs, or NULL. */
+    Tk_Font tkfont,		/* Font to measure in. */
+    CONST char *string,		/* String being layed out. */
+    CONST char *start,		/* First character to measure. */
+    int numBytes,		/* Number of bytes to consider. */
+    int maxLength,		/* Same as Tk_MeasureChars(). */
+    int flags,			/* Same as Tk_MeasureChars(). */
+    int *lengthPtr		/* Returned width. */
+    )
+{
+    LayoutRun *runPtr;
+    int i, offset, end, x, x0, term = -1, termX = 0;
+
+    if (wordsPtr == NULL)
+	goto measure;
+    if ((maxLength >= 0) && !(flags & TK_WHOLE_WORDS))
+	goto measure;
+
+    offset = start - string;
+    end = offset + numBytes;
+    i = LayoutWords_RunAt(wordsPtr, offset);
+    if (i == -1)
+	goto measure;
+    x0 = (i > 0) ? wordsPtr->runs[i - 1].x : 0;
+
+    for (; ; i++) {
+	if (i == wordsPtr->numRuns) {
+	    LayoutWords_Fill(wordsPtr, wordsPtr->measured);
+	    if (i == wordsPtr->numRuns)
+		goto measure;
+	}
+	runPtr = &wordsPtr->runs[i];
+	if (runPtr->end > end)
+	    goto measure;
+	x = runPtr->x - x0;
+	if ((maxLength >= 0) && (x > maxLength))
+	    break;
+	if (runPtr->end == end) {
+	    (*lengthPtr) = x;
+	    return numBytes;
+	}
+
+	/* Like Tk_MeasureChars(), break after a word followed by a space. */
+	if (!runPtr->space) {
+	    term = runPtr->end;
+	    termX = x;
+	}
+    }
+    if (term != -1) {
+	(*lengthPtr) = termX;
+	return term - offset;
+    }
+
+measure:
+    return Tk_MeasureChars(tkfont, start, numBytes, maxLength, flags,
+	lengthPtr);
+}
+
 #ifdef TEXTLAYOUT_ALLOCHAX
 static LayoutChunk *NewChunk(LayoutInfo **layoutPtrPtr,
 #else
@@ -1662,7 +2239,10 @@ static LayoutChunk *NewChunk(LayoutInfo **layoutPtrPtr, int *maxPtr,
     return chunkPtr;
 }
 
-TextLayout TextLayout_Compute(
+static TextLayout
+ComputeLayout(
+    TreeCtrl *tree,		/* Widget info. */
+    LayoutWords *wordsPtr,	/* Word widths of string, or NULL. */
     Tk_Font tkfont,		/* Font that will be used to display text. */
     CONST char *string,		/* String whose dimensions are to be
 				** computed. */
@@ -1721,6 +2301,7 @@ TextLayout TextLayout_Compute(
 #endif
     layoutPtr->tkfont = tkfont;
     layoutPtr->string = string;
+    layoutPtr->words = wordsPtr;
     layoutPtr->numChunks = 0;
     layoutPtr->numLines = 0;
 
@@ -1750,8 +2331,8 @@ TextLayout TextLayout_Compute(
 
 	chunkPtr = NULL;
 	if (start < special) {
-	    bytesThisChunk = Tk_MeasureChars(tkfont, start, special - start,
-		wrapLength - curX, flags, &newX);
+	    bytesThisChunk = LayoutMeasure(wordsPtr, tkfont, string, start,
+		special - start, wrapLength - curX, flags, &newX);
 	    newX += curX;
 	    flags &= ~TK_AT_LEAST_ONE;
 	    if (bytesThisChunk > 0) {
@@ -1814,8 +2395,8 @@ TextLayout TextLayout_Compute(
 	    bytesThisChunk = start - end;
 	    if (bytesThisChunk > 0) {
 		bytesThisChunk =
-		    Tk_MeasureChars(tkfont, end, bytesThisChunk, -1, 0,
-		    &chunkPtr->totalWidth);
+		    LayoutMeasure(wordsPtr, tkfont, string, end,
+		    bytesThisChunk, -1, 0, &chunkPtr->totalWidth);
 		chunkPtr->numBytes += bytesThisChunk;
 		chunkPtr->numChars += Tcl_NumUtfChars(end, bytesThisChunk);
 		chunkPtr->totalWidth += curX;
@@ -1880,7 +2461,7 @@ wrapLine:
 		    pixelsForText = wrapLength - chunkPtr->x;
 		else
 		    pixelsForText = chunkPtr->totalWidth - 1;
-		bytesThisChunk = Tree_Ellipsis(tkfont,
+		bytesThisChunk = Tree_Ellipsis(tree, tkfont,
 			(char *) chunkPtr->start, chunkPtr->numBytes,
 			&pixelsForText, ellipsis, TRUE);
 		if (pixelsForText > wrapLength - chunkPtr->x)
@@ -1977,15 +2558,98 @@ if (chunkPtr->x + chunkPtr->totalWidth > layoutPtr->totalWidth)
     return (TextLayout) layoutPtr;
 }
 
-void TextLayout_Free(TextLayout textLayout)
-{
-    LayoutInfo *layoutPtr = (LayoutInfo *) textLayout;
-
-#ifdef TEXTLAYOUT_ALLOCHAX
-    Tcl_MutexLock(&textLayoutMutex);
-    layoutPtr->nextFree = freeLayoutInfo;
-    freeLayoutInfo = layoutPtr;
-    Tcl_MutexUnlock(&textLayoutMutex);
+TextLayout TextLayout_Compute(
+    TreeCtrl *tree,		/* Widget info. */
+    Tk_Font tkfont,		/* Font that will be used to display text. */
+    CONST char *string,		/* String whose dimensions are to be
+				** computed. */
+    int numChars,		/* Number of characters to consider from
+				** string, or < 0 for strlen(). */
+    int wrapLength,		/* Longest permissible line length, in
+				** pixels.  <= 0 means no automatic wrapping:
+				** just let lines get as long as needed. */
+    Tk_Justify justify,		/* How to justify lines. */
+    int maxLines,
+    int flags			/* Same as ComputeLayout(). */
+    )
+{
+    return ComputeLayout(tree, NULL, tkfont, string, numChars, wrapLength,
+	justify, maxLines, flags);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TextLayout_Reflow --
+ *
+ *	Like TextLayout_Compute(), but for a string that was layed out
+ *	before, typically at a different width. The widths of the words
+ *	in the string are kept by the old layout, so when the font and
+ *	the string are unchanged only the line breaks are recalculated.
+ *
+ * Results:
+ *	A new TextLayout.
+ *
+ * Side effects:
+ *	The old layout is freed.
+ *
+ *----------------------------------------------------------------------
+ */
+
+TextLayout
+TextLayout_Reflow(
+    TreeCtrl *tree,		/* Widget info. */
+    TextLayout textLayout,	/* Old layout, or NULL. */
+    Tk_Font tkfont,		/* Font that will be used to display text. */
+    CONST char *string,		/* String to lay out. */
+    int numChars,		/* Same as TextLayout_Compute(). */
+    int wrapLength,		/* Same as TextLayout_Compute(). */
+    Tk_Justify justify,		/* How to justify lines. */
+    int maxLines,
+    int flags			/* Same as TextLayout_Compute(). */
+    )
+{
+    LayoutInfo *layoutPtr = (LayoutInfo *) textLayout;
+    LayoutWords *wordsPtr = NULL;
+    int numBytes;
+
+    if (numChars < 0)
+	numChars = Tcl_NumUtfChars(string, -1);
+    numBytes = Tcl_UtfAtIndex(string, numChars) - string;
+
+    if (layoutPtr != NULL) {
+	wordsPtr = layoutPtr->words;
+	layoutPtr->words = NULL;
+	TextLayout_Free(textLayout);
+	if ((wordsPtr != NULL) && ((wordsPtr->tkfont != tkfont) ||
+		(wordsPtr->numBytes != numBytes) ||
+		memcmp(wordsPtr->string, string, numBytes))) {
+	    LayoutWords_Free(wordsPtr);
+	    wordsPtr = NULL;
+	}
+
+	/* Only text that is reflowed keeps its word widths. Most text
+	 * is never layed out more than once and needn't pay for them. */
+	if ((wordsPtr == NULL) && (flags & TK_WHOLE_WORDS))
+	    wordsPtr = LayoutWords_New(tkfont, string, numBytes);
+    }
+
+    return ComputeLayout(tree, wordsPtr, tkfont, string, numChars, wrapLength,
+	justify, maxLines, flags);
+}
+
+void TextLayout_Free(TextLayout textLayout)
+{
+    LayoutInfo *layoutPtr = (LayoutInfo *) textLayout;
+
+    if (layoutPtr->words != NULL)
+	LayoutWords_Free(layoutPtr->words);
+
+#ifdef TEXTLAYOUT_ALLOCHAX
+    Tcl_MutexLock(&textLayoutMutex);
+    layoutPtr->nextFree = freeLayoutInfo;
+    freeLayoutInfo = layoutPtr;
+    Tcl_MutexUnlock(&textLayoutMutex);
 #else
     ckfree((char *) layoutPtr);
 #endif
@@ -2362,6 +3026,20 @@ ObjectIsEmpty(
 
 #define PERSTATE_ROUNDUP 5
 
+/*
+ * PerStateInfo_ForState() remembers its result for a few states in a
+ * direct-mapped cache. A result is stored as the index of the matching
+ * PerStateData plus one, and the MATCH_xxx constant; the low bit is set
+ * so zero means an unused slot. The cache must be cleared whenever the
+ * PerStateData array changes.
+ */
+
+#define PERSTATE_CACHE_SLOT(state) \
+    ((int) (((unsigned int) (state) * 2654435761U) >> 24) & \
+    (PERSTATE_CACHE_SIZE - 1))
+#define PERSTATE_CACHE_RESULT(index, match) \
+    ((((index) + 1) << 3) | ((match) << 1) | 1)
+
 /*
  *----------------------------------------------------------------------
  *
@@ -2389,6 +3067,8 @@ PerStateInfo_Free(
     PerStateData *pData = pInfo->data;
     int i;
 
+    PerStateInfo_ClearCache(pInfo);
+
     if (pInfo->data == NULL)
 	return;
 
@@ -2541,7 +3221,7 @@ freeIt:
  *	no appropriate PerStateData was found.
  *
  * Side effects:
- *	None.
+ *	The result is remembered for the next lookup of the same state.
  *
  *----------------------------------------------------------------------
  */
@@ -2557,7 +3237,7 @@ PerStateInfo_ForState(
 {
     PerStateData *pData = pInfo->data;
     int stateOff = ~state, stateOn = state;
-    int i;
+    int i, slot = 0, result, m = MATCH_NONE;
 
 #ifdef TREECTRL_DEBUG
     if ((pInfo->data != NULL) && (pInfo->type != typePtr)) {
@@ -2566,33 +3246,55 @@ PerStateInfo_ForState(
     }
 #endif
 
+    /* With only one value the search is as fast as the cache. */
+    if (pInfo->count > 1) {
+	slot = PERSTATE_CACHE_SLOT(state);
+	result = pInfo->cacheResult[slot];
+	if ((result != 0) && (pInfo->cacheState[slot] == state)) {
+	    if (match) (*match) = (result >> 1) & 3;
+	    i = (result >> 3) - 1;
+	    if (i < 0)
+		return NULL;
+	    return (PerStateData *) (((char *) pData) + i * typePtr->size);
+	}
+    }
+
     for (i = 0; i < pInfo->count; i++) {
 	/* Any state */
 	if ((pData->stateOff == 0) &&
 		(pData->stateOn == 0)) {
-	    if (match) (*match) = MATCH_ANY;
-	    return pData;
+	    m = MATCH_ANY;
+	    break;
 	}
 
 	/* Exact match */
 	if ((pData->stateOff == stateOff) &&
 		(pData->stateOn == stateOn)) {
-	    if (match) (*match) = MATCH_EXACT;
-	    return pData;
+	    m = MATCH_EXACT;
+	    break;
 	}
 
 	/* Partial match */
 	if (((pData->stateOff & stateOff) == pData->stateOff) &&
 		((pData->stateOn & stateOn) == pData->stateOn)) {
-	    if (match) (*match) = MATCH_PARTIAL;
-	    return pData;
+	    m = MATCH_PARTIAL;
+	    break;
 	}
 
 	pData = (PerStateData *) (((char *) pData) + typePtr->size);
     }
+    if (m == MATCH_NONE) {
+	i = -1;
+	pData = NULL;
+    }
 
-    if (match) (*match) = MATCH_NONE;
-    return NULL;
+    if (pInfo->count > 1) {
+	pInfo->cacheState[slot] = state;
+	pInfo->cacheResult[slot] = PERSTATE_CACHE_RESULT(i, m);
+    }
+
+    if (match) (*match) = m;
+    return pData;
 }
 
 /*
@@ -2709,6 +3411,7 @@ PerStateInfo_Undefine(
 	if ((pData->stateOff | pData->stateOn) & state) {
 	    pData->stateOff &= ~state;
 	    pData->stateOn &= ~state;
+	    PerStateInfo_ClearCache(pInfo);
 	    if (Tcl_IsShared(configObj)) {
 		configObj = DuplicateListObj(configObj);
 		Tcl_DecrRefCount(pInfo->obj);
@@ -2806,6 +3509,444 @@ Tree_FreeAllGC(
 
 /*****/
 
+/*
+ * A cache of the widths of recently-measured strings is kept for each
+ * widget. Rows often repeat the same strings in the same font, so each
+ * distinct string is only passed to the font code once. The entries are
+ * kept in most-recently-used order and the oldest one is discarded when
+ * the cache is full.
+ */
+
+#define TEXT_CACHE_SIZE 1024	/* Maximum number of entries. */
+#define TEXT_CACHE_MAX_BYTES 256 /* Longer strings aren't cached. */
+
+typedef struct TextCacheEntry TextCacheEntry;
+struct TextCacheEntry
+{
+    Tcl_HashEntry *hPtr;	/* Entry in TreeTextCache.table. */
+    int width;			/* Width of the string in pixels. */
+    TextCacheEntry *prev;	/* Next most-recently-used entry. */
+    TextCacheEntry *next;	/* Next least-recently-used entry. */
+};
+
+/*
+ * The widths of the printable ASCII characters in a font, which are
+ * measured the first time they are needed. When the width of a string
+ * in the font is the sum of the widths of its characters (no kerning or
+ * ligatures) ASCII strings can be measured without calling the font code.
+ */
+
+#define ASCII_WIDTHS_SAMPLE "AVAWATLTLYPAFAToTaWaYoVaffiflLjAy.,/\\"
+
+struct AsciiWidths
+{
+    Tk_Font tkfont;		/* Reference to the font. See
+				 * TextCache_Font(). */
+    int additive;		/* TRUE if strings can be measured by adding
+				 * up the widths of their characters. */
+    int width[128];		/* Width of each character or -1 if it
+				 * wasn't measured yet. */
+};
+
+struct TreeTextCache
+{
+    Tcl_HashTable fontTable;	/* Font name -> AsciiWidths, for every
+				 * font in either table. */
+    Tcl_HashTable table;	/* Font name + string -> TextCacheEntry. */
+    TextCacheEntry *head;	/* Most-recently-used entry. */
+    TextCacheEntry *tail;	/* Least-recently-used entry. */
+    int count;			/* Number of entries. */
+    Tcl_DString key;		/* Used to build hash keys. */
+    long hits;			/* Number of lookups that found an entry. */
+    long misses;		/* Number of lookups that measured text. */
+};
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TextCache_Get --
+ *
+ *	Return the widget's text cache, creating it if needed.
+ *
+ * Results:
+ *	Pointer to the cache.
+ *
+ * Side effects:
+ *	Memory may be allocated.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static TreeTextCache *
+TextCache_Get(
+    TreeCtrl *tree		/* Widget info. */
+    )
+{
+    TreeTextCache *cache = tree->textCache;
+
+    if (cache == NULL) {
+	cache = (TreeTextCache *) ckalloc(sizeof(TreeTextCache));
+	Tcl_InitHashTable(&cache->fontTable, TCL_STRING_KEYS);
+	Tcl_InitHashTable(&cache->table, TCL_STRING_KEYS);
+	cache->head = cache->tail = NULL;
+	cache->count = 0;
+	Tcl_DStringInit(&cache->key);
+	cache->hits = cache->misses = 0;
+	tree->textCache = cache;
+    }
+    return cache;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TextIsAscii --
+ *
+ *	Determine whether a string contains only printable ASCII
+ *	characters. Tabs, newlines and other control characters are
+ *	displayed specially by Tk so they don't qualify.
+ *
+ * Results:
+ *	TRUE or FALSE.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+TextIsAscii(
+    CONST char *text,		/* String to check. */
+    int numBytes		/* Number of bytes in text. */
+    )
+{
+    CONST unsigned char *p = (CONST unsigned char *) text;
+    CONST unsigned char *end = p + numBytes;
+
+    while (p < end) {
+	if ((*p < 0x20) || (*p >= 0x7F))
+	    return FALSE;
+	p++;
+    }
+    return TRUE;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TextCache_Font --
+ *
+ *	Return the table of ASCII character widths for a font, creating
+ *	it if needed. When the table is created, a sample string full
+ *	of commonly-kerned pairs is measured to check that the font
+ *	doesn't use kerning or ligatures.
+ *
+ *	The table holds a reference to the font. Otherwise a named font
+ *	no longer used by anything could be deleted and created again
+ *	with different metrics, which Tk doesn't report as a change of
+ *	the world, and the widths cached under its name would be wrong.
+ *	With the reference, Tk calls TreeWorldChanged() when the font
+ *	is created again, which frees the cache.
+ *
+ * Results:
+ *	Pointer to the table, or NULL if the font couldn't be
+ *	referenced, in which case nothing should be cached.
+ *
+ * Side effects:
+ *	Memory may be allocated.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static AsciiWidths *
+TextCache_Font(
+    TreeCtrl *tree,		/* Widget info. */
+    Tk_Font tkfont		/* Font. */
+    )
+{
+    TreeTextCache *cache = TextCache_Get(tree);
+    AsciiWidths *aw;
+    Tcl_HashEntry *hPtr;
+    CONST char *sample = ASCII_WIDTHS_SAMPLE;
+    Tk_Font tkfontRef;
+    int i, isNew, pixels = 0;
+
+    hPtr = Tcl_CreateHashEntry(&cache->fontTable, Tk_NameOfFont(tkfont),
+	&isNew);
+    if (!isNew)
+	return (AsciiWidths *) Tcl_GetHashValue(hPtr);
+
+    tkfontRef = Tk_GetFont(tree->interp, tree->tkwin, Tk_NameOfFont(tkfont));
+    if (tkfontRef == NULL) {
+	Tcl_DeleteHashEntry(hPtr);
+	return NULL;
+    }
+
+    aw = (AsciiWidths *) ckalloc(sizeof(AsciiWidths));
+    aw->tkfont = tkfontRef;
+    for (i = 0; i < 128; i++)
+	aw->width[i] = -1;
+    for (i = 0; sample[i] != '\0'; i++)
+	pixels += AsciiWidths_Char(aw, tkfont, sample[i]);
+    aw->additive = (pixels == Tk_TextWidth(tkfont, sample, i));
+    Tcl_SetHashValue(hPtr, (ClientData) aw);
+
+    return aw;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TextCache_AsciiWidths --
+ *
+ *	Return the table of ASCII character widths for a font if the
+ *	widths of strings in the font can be found by adding up
+ *	character widths.
+ *
+ * Results:
+ *	Pointer to the table, or NULL.
+ *
+ * Side effects:
+ *	Memory may be allocated.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static AsciiWidths *
+TextCache_AsciiWidths(
+    TreeCtrl *tree,		/* Widget info. */
+    Tk_Font tkfont		/* Font. */
+    )
+{
+    AsciiWidths *aw = TextCache_Font(tree, tkfont);
+
+    return ((aw != NULL) && aw->additive) ? aw : NULL;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * AsciiWidths_Char --
+ *
+ *	Return the width of a printable ASCII character, measuring it
+ *	the first time.
+ *
+ * Results:
+ *	Width in pixels.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+AsciiWidths_Char(
+    AsciiWidths *aw,		/* Table of widths for tkfont. */
+    Tk_Font tkfont,		/* Font. */
+    int ch			/* Printable ASCII character. */
+    )
+{
+    if (aw->width[ch] == -1) {
+	char buf = (char) ch;
+	aw->width[ch] = Tk_TextWidth(tkfont, &buf, 1);
+    }
+    return aw->width[ch];
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * Tree_TextWidth --
+ *
+ *	Return the width of a string in the given font, like
+ *	Tk_TextWidth(). The result is remembered in the widget's text
+ *	cache. The cache is keyed on the font's name rather than the
+ *	Tk_Font, since a freed font's token could be reused for a
+ *	different font. Fonts with the same name have the same
+ *	metrics until the world changes, because the cache holds a
+ *	reference to each font (see TextCache_Font()).
+ *
+ * Results:
+ *	Width in pixels.
+ *
+ * Side effects:
+ *	Memory may be allocated.
+ *
+ *----------------------------------------------------------------------
+ */
+
+int
+Tree_TextWidth(
+    TreeCtrl *tree,		/* Widget info. */
+    Tk_Font tkfont,		/* Font to measure with. */
+    CONST char *text,		/* String to measure. */
+    int numBytes		/* Number of bytes in text. */
+    )
+{
+    TreeTextCache *cache;
+    TextCacheEntry *entry;
+    AsciiWidths *aw;
+    Tcl_HashEntry *hPtr;
+    CONST char *fontName;
+    char buf[TCL_INTEGER_SPACE + 1];
+    int i, isNew, width;
+
+    /* Adding up character widths is cheaper than a hash lookup. */
+    if (TextIsAscii(text, numBytes) &&
+	    ((aw = TextCache_AsciiWidths(tree, tkfont)) != NULL)) {
+	for (i = 0, width = 0; i < numBytes; i++)
+	    width += AsciiWidths_Char(aw, tkfont, text[i]);
+	return width;
+    }
+
+    if ((numBytes > TEXT_CACHE_MAX_BYTES) ||
+	    (TextCache_Font(tree, tkfont) == NULL))
+	return Tk_TextWidth(tkfont, text, numBytes);
+
+    cache = TextCache_Get(tree);
+
+    /* The length prefix keeps font names and strings from running
+     * together. */
+    fontName = Tk_NameOfFont(tkfont);
+    sprintf(buf, "%d:", (int) strlen(fontName));
+    Tcl_DStringSetLength(&cache->key, 0);
+    Tcl_DStringAppend(&cache->key, buf, -1);
+    Tcl_DStringAppend(&cache->key, fontName, -1);
+    Tcl_DStringAppend(&cache->key, text, numBytes);
+
+    hPtr = Tcl_CreateHashEntry(&cache->table, Tcl_DStringValue(&cache->key),
+	&isNew);
+    if (!isNew) {
+	entry = (TextCacheEntry *) Tcl_GetHashValue(hPtr);
+	cache->hits++;
+
+	/* Move it to the front of the list. */
+	if (entry != cache->head) {
+	    entry->prev->next = entry->next;
+	    if (entry->next != NULL)
+		entry->next->prev = entry->prev;
+	    else
+		cache->tail = entry->prev;
+	    entry->prev = NULL;
+	    entry->next = cache->head;
+	    cache->head->prev = entry;
+	    cache->head = entry;
+	}
+	return entry->width;
+    }
+
+    cache->misses++;
+
+    /* Reuse the least-recently-used entry if the cache is full. */
+    if (cache->count == TEXT_CACHE_SIZE) {
+	entry = cache->tail;
+	Tcl_DeleteHashEntry(entry->hPtr);
+	cache->tail = entry->prev;
+	cache->tail->next = NULL;
+    } else {
+	entry = (TextCacheEntry *) ckalloc(sizeof(TextCacheEntry));
+	cache->count++;
+	if (cache->tail == NULL)
+	    cache->tail = entry;
+    }
+    entry->hPtr = hPtr;
+    entry->width = Tk_TextWidth(tkfont, text, numBytes);
+    entry->prev = NULL;
+    entry->next = cache->head;
+    if (cache->head != NULL)
+	cache->head->prev = entry;
+    cache->head = entry;
+    Tcl_SetHashValue(hPtr, (ClientData) entry);
+
+    return entry->width;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * Tree_FreeTextCache --
+ *
+ *	Discard every width in the widget's text cache. This must be
+ *	called when the metrics of a font may have changed.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Memory is freed.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+Tree_FreeTextCache(
+    TreeCtrl *tree		/* Widget info. */
+    )
+{
+    TreeTextCache *cache = tree->textCache;
+    TextCacheEntry *entry, *next;
+    Tcl_HashEntry *hPtr;
+    Tcl_HashSearch search;
+
+    if (cache == NULL)
+	return;
+
+    for (entry = cache->head; entry != NULL; entry = next) {
+	next = entry->next;
+	WFREE(entry, TextCacheEntry);
+    }
+    Tcl_DeleteHashTable(&cache->table);
+
+    hPtr = Tcl_FirstHashEntry(&cache->fontTable, &search);
+    while (hPtr != NULL) {
+	AsciiWidths *aw = (AsciiWidths *) Tcl_GetHashValue(hPtr);
+	Tk_FreeFont(aw->tkfont);
+	WFREE(aw, AsciiWidths);
+	hPtr = Tcl_NextHashEntry(&search);
+    }
+    Tcl_DeleteHashTable(&cache->fontTable);
+    Tcl_DStringFree(&cache->key);
+    WFREE(cache, TreeTextCache);
+    tree->textCache = NULL;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * Tree_TextCacheStats --
+ *
+ *	Set the interpreter result to a description of the widget's
+ *	text cache.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+Tree_TextCacheStats(
+    TreeCtrl *tree,		/* Widget info. */
+    Tcl_Interp *interp		/* Current interpreter. */
+    )
+{
+    TreeTextCache *cache = tree->textCache;
+
+    if (cache == NULL) {
+	FormatResult(interp, "entries 0 hits 0 misses 0");
+	return;
+    }
+    FormatResult(interp, "entries %d hits %ld misses %ld",
+	cache->count, cache->hits, cache->misses);
+}
+
+/*****/
+
 typedef struct PerStateDataBitmap PerStateDataBitmap;
 struct PerStateDataBitmap
 {
@@ -3275,6 +4416,7 @@ PSTSave(
     pSave->count = pInfo->count;
     pInfo->data = NULL;
     pInfo->count = 0;
+    PerStateInfo_ClearCache(pInfo);
 }
 
 void
@@ -3358,6 +4500,10 @@ struct AllocData
 #ifdef ALLOC_STATS
     AllocStats *stats;		/* For memory-usage reporting. */
 #endif
+#ifdef TREECTRL_BENCH
+    unsigned long allocCount;	/* Number of TreeAlloc_Alloc() calls. */
+    unsigned long blockCount;	/* Number of blocks ckalloc()'d. */
+#endif
 };
 
 #ifdef ALLOC_STATS
@@ -3469,6 +4615,9 @@ TreeAlloc_Alloc(
     stats->count++;
     stats->size += size;
 #endif
+#ifdef TREECTRL_BENCH
+    data->allocCount++;
+#endif
 
     while ((freeList != NULL) && (freeList->size != size))
 	freeList = freeList->next;
@@ -3491,6 +4640,9 @@ TreeAlloc_Alloc(
 		elemSize * freeList->blockSize);
 	block->count = freeList->blockSize;
 	block->next = freeList->blocks;
+#ifdef TREECTRL_BENCH
+	data->blockCount++;
+#endif
 
 /* dbwin("TreeAlloc_Alloc alloc %d of size %d\n", freeList->blockSize, size); */
 	freeList->blocks = block;
@@ -3729,10 +4881,48 @@ TreeAlloc_Init(void)
     data->freeLists = NULL;
 #ifdef ALLOC_STATS
     data->stats = NULL;
+#endif
+#ifdef TREECTRL_BENCH
+    data->allocCount = data->blockCount = 0;
 #endif
     return data;
 }
 
+#ifdef TREECTRL_BENCH
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TreeAlloc_Counts --
+ *
+ *	Return the running totals of allocations for the benchmark
+ *	command.
+ *
+ * Results:
+ *	The number of TreeAlloc_Alloc() calls and the number of blocks
+ *	of memory obtained from ckalloc() since TreeAlloc_Init().
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+TreeAlloc_Counts(
+    ClientData _data,		/* Token returned by TreeAlloc_Init(). */
+    unsigned long *allocPtr,	/* Returned number of allocations. */
+    unsigned long *blockPtr	/* Returned number of blocks. */
+    )
+{
+    AllocData *data = (AllocData *) _data;
+
+    (*allocPtr) = data->allocCount;
+    (*blockPtr) = data->blockCount;
+}
+
+#endif /* TREECTRL_BENCH */
+
 /*
  *----------------------------------------------------------------------
  *
@@ -5110,6 +6300,7 @@ PerStateCO_Set(
 	new.obj = (*value);
 	new.data = NULL;
 	new.count = 0;
+	PerStateInfo_ClearCache(&new);
 /*	Tcl_IncrRefCount((*value));*/
 	if (PerStateInfo_FromObj(tree, cd->proc, cd->typePtr, &new) != TCL_OK) {
 /*	    Tcl_DecrRefCount((*value));*/
@@ -5121,6 +6312,7 @@ PerStateCO_Set(
 	    new.obj = NULL;
 	    new.data = NULL;
 	    new.count = 0;
+	    PerStateInfo_ClearCache(&new);
 	}
 	OptionHax_Remember(tree, saveInternalPtr);
 	if (internalPtr->obj != NULL) {
@@ -5161,6 +6353,7 @@ PerStateCO_Restore(
     PerStateInfo *psi = (PerStateInfo *) internalPtr;
     PerStateInfo *hax = *(PerStateInfo **) saveInternalPtr;
 /*dbwin("PerStateCO_Restore\n");*/
+    PerStateInfo_ClearCache(psi);
     if (hax != NULL) {
 #ifdef TREECTRL_DEBUG
 	psi->type = hax->type;
@@ -285,7 +285,7 @@ proc ::TreeCtrl::ColumnDragFindBefore {w x y dragColumn indColumn_ indSide_} {
     if {$x >= $maxX} {
 	set x [expr {$maxX - 1}]
     }
-    set id [$w identify $x $y]
+    set id [$w identify -rowonly $x $y]
     if {[lindex $id 0] ne "header"} {
 	return 0
     }
@@ -325,7 +325,7 @@ proc ::TreeCtrl::ColumnDragFindBefore {w x y dragColumn indColumn_ indSide_} {
 
 proc ::TreeCtrl::CursorAction {w x y} {
     variable Priv
-    set id [$w identify $x $y]
+    set id [$w identify -rowonly $x $y]
 
     if {[lindex $id 0] eq "header"} {
 	set column [lindex $id 1]
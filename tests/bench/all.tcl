@@ -0,0 +1,34 @@
+# all.tcl --
+#
+# Run the treectrl benchmarks. Every *.tcl file in this directory except
+# this one and bench.tcl registers some scenarios. Each scenario runs at
+# each size in a separate process, so peak_rss_kb is the peak of that run
+# alone. Results are written as one JSON object per line. Options:
+#
+#   -sizes {10000 ...}	Numbers of items to run each scenario with.
+#   -match pattern	Only run scenarios whose name matches.
+#   -output file	Append results to a file instead of stdout.
+#   -maxpages n		Stop the page-by-page scroll after n pages.
+#   -commandmax n	Largest list sorted with [item sort -command].
+#
+# For example:
+#
+#   make bench BENCHFLAGS="-sizes 10000 -match sort"
+#
+# See the file "license.terms" for information on usage and redistribution
+# of this file, and for a DISCLAIMER OF ALL WARRANTIES.
+
+package require Tk
+package require treectrl
+
+set dir [file dirname [file normalize [info script]]]
+source [file join $dir bench.tcl]
+foreach file [lsort [glob -directory $dir *.tcl]] {
+    switch -- [file tail $file] {
+	all.tcl - bench.tcl {}
+	default { source $file }
+    }
+}
+
+bench::run $argv
+exit
@@ -0,0 +1,270 @@
+# bench.tcl --
+#
+# Support procedures for the treectrl benchmarks. Each benchmark file
+# registers scenarios with [bench::scenario]. A scenario is run once for
+# every list size and times one or more phases with [bench::phase]. Every
+# phase writes one line of JSON so results from different releases can be
+# compared with ordinary tools.
+#
+# Every scenario runs at every size in a process of its own, so the peak
+# resident set size of one run isn't inflated by the runs before it.
+#
+# See the file "license.terms" for information on usage and redistribution
+# of this file, and for a DISCLAIMER OF ALL WARRANTIES.
+
+namespace eval bench {
+    variable Option
+    array set Option {
+	-sizes {10000 100000 1000000}
+	-match *
+	-output {}
+	-maxpages 0
+	-commandmax 100000
+	-scenario {}
+    }
+    variable Dir [file dirname [file normalize [info script]]]
+    variable Scenarios {}
+    variable Chan stdout
+    variable Current
+}
+
+# bench::scenario --
+#
+# Register a benchmark scenario. The body is evaluated in the global
+# namespace with the variables T (the treectrl) and N (the number of
+# items) set.
+
+proc bench::scenario {name body} {
+    variable Scenarios
+    lappend Scenarios $name $body
+    return
+}
+
+# bench::phase --
+#
+# Time one phase of the current scenario. The script is evaluated once in
+# the caller's context. It may return the number of operations it
+# performed, otherwise one operation is assumed. The result of the phase
+# is written as a line of JSON.
+
+proc bench::phase {name script} {
+    variable Current
+
+    set t1 [clock microseconds]
+    set ops [uplevel 1 $script]
+    set usec [expr {[clock microseconds] - $t1}]
+    if {![string is integer -strict $ops]} {
+	set ops 1
+    }
+    if {$usec > 0} {
+	set rate [format %.2f [expr {$ops * 1000000.0 / $usec}]]
+    } else {
+	set rate null
+    }
+    Emit [list \
+	scenario $Current(scenario) \
+	phase $name \
+	items $Current(items) \
+	ops $ops \
+	usec $usec \
+	ops_per_sec $rate \
+	peak_rss_kb [PeakRSS]]
+    return
+}
+
+# bench::PeakRSS --
+#
+# Return the peak resident set size of this process in kilobytes, or
+# null if the system doesn't say. The process runs a single scenario at a
+# single size, so this is the peak of that run plus the memory needed to
+# start wish.
+
+proc bench::PeakRSS {} {
+    if {[catch {open /proc/self/status} chan]} {
+	return null
+    }
+    set data [read $chan]
+    close $chan
+    if {[regexp -line {^VmHWM:\s+(\d+)} $data -> kb]} {
+	return $kb
+    }
+    return null
+}
+
+# bench::Emit --
+#
+# Write a list of key/value pairs as one JSON object. The values of the
+# measurement keys are written as numbers (or null), everything else as
+# a string.
+
+proc bench::Emit {pairs} {
+    variable Chan
+
+    set fields {}
+    foreach {key value} $pairs {
+	if {[lsearch -exact {items ops usec ops_per_sec peak_rss_kb} $key]
+	    != -1} {
+	    lappend fields "\"$key\": $value"
+	} else {
+	    set value [string map {\\ \\\\ \" \\\" \n \\n \t \\t} $value]
+	    lappend fields "\"$key\": \"$value\""
+	}
+    }
+    puts $Chan "{[join $fields {, }]}"
+    flush $Chan
+    return
+}
+
+# bench::NewTree --
+#
+# Create a fresh treectrl with two text columns, each with its own style.
+
+proc bench::NewTree {} {
+    destroy .t
+    treectrl .t -width 400 -height 400 -showroot no -showheader yes \
+	-selectmode extended -itemheight 18 -yscrollincrement 0
+    pack .t -expand yes -fill both
+    .t element create e1 text
+    .t element create e2 text
+    .t style create S1
+    .t style elements S1 e1
+    .t style create S2
+    .t style elements S2 e2
+    .t column create -text Item -tags C0 -itemstyle S1
+    .t column create -text Value -tags C1 -itemstyle S2
+    .t configure -treecolumn C0
+    update
+    return .t
+}
+
+# bench::Populate --
+#
+# Fill the list with N items. With a fanout of zero all items are
+# children of the root, otherwise every top-level item gets that many
+# children. Column C0 holds "Item <n>" and column C1 a scrambled integer
+# so that sorting has some work to do. Returns the ids of the items.
+
+proc bench::Populate {T N {fanout 0}} {
+    if {$fanout > 0} {
+	set parents [$T item create -count [expr {$N / ($fanout + 1)}] \
+	    -parent root -button auto]
+	set items {}
+	foreach P $parents {
+	    lappend items $P
+	    eval lappend items [$T item create -count $fanout -parent $P \
+		-open no]
+	}
+    } else {
+	set items [$T item create -count $N -parent root]
+    }
+    set i 0
+    foreach I $items {
+	$T item text $I C0 "Item $i" C1 [expr {($i * 7919) % $N}]
+	incr i
+    }
+    return $items
+}
+
+# bench::run --
+#
+# Parse the command line and run every matching scenario at every size.
+# Each run is done by a child process started with -scenario, which runs
+# that one scenario and writes its results to stdout.
+
+proc bench::run {argv} {
+    variable Option
+    variable Chan
+    variable Scenarios
+
+    foreach {option value} $argv {
+	if {![info exists Option($option)]} {
+	    error "bad option \"$option\": must be\
+		[join [lsort [array names Option]] {, }]"
+	}
+	set Option($option) $value
+    }
+
+    if {$Option(-scenario) ne ""} {
+	RunOne $Option(-scenario) $Option(-sizes)
+	return
+    }
+
+    if {$Option(-output) ne ""} {
+	set Chan [open $Option(-output) a]
+    }
+
+    Emit [list \
+	scenario info \
+	treectrl [package require treectrl] \
+	tk [package require Tk] \
+	tcl [info patchlevel] \
+	platform $::tcl_platform(os)-$::tcl_platform(osVersion) \
+	windowingsystem [tk windowingsystem] \
+	started [clock format [clock seconds] -format %Y-%m-%dT%H:%M:%S]]
+
+    foreach N $Option(-sizes) {
+	foreach {name body} $Scenarios {
+	    if {![string match $Option(-match) $name]} continue
+	    RunChild $name $N
+	}
+    }
+
+    if {$Chan ne "stdout"} {
+	close $Chan
+	set Chan stdout
+    }
+    return
+}
+
+# bench::RunChild --
+#
+# Run one scenario at one size in a new process and copy its results.
+
+proc bench::RunChild {name N} {
+    variable Option
+    variable Dir
+    variable Chan
+
+    set command [list [info nameofexecutable] [file join $Dir all.tcl] \
+	-scenario $name -sizes $N \
+	-maxpages $Option(-maxpages) -commandmax $Option(-commandmax)]
+    if {[catch {open |[concat $command [list 2>@1]] r} pipe]} {
+	Emit [list scenario $name items $N error $pipe]
+	return
+    }
+    while {[gets $pipe line] >= 0} {
+	puts $Chan $line
+	flush $Chan
+    }
+    if {[catch {close $pipe} msg]} {
+	Emit [list scenario $name items $N error $msg]
+    }
+    return
+}
+
+# bench::RunOne --
+#
+# Run a single scenario at a single size in this process.
+
+proc bench::RunOne {name N} {
+    variable Scenarios
+    variable Current
+
+    foreach {scenario body} $Scenarios {
+	if {$scenario ne $name} continue
+	set Current(scenario) $name
+	set Current(items) $N
+	set T [NewTree]
+	if {[catch {
+	    namespace eval :: [list set T $T]
+	    namespace eval :: [list set N $N]
+	    namespace eval :: $body
+	} msg]} {
+	    Emit [list scenario $name items $N error $msg]
+	}
+	destroy $T
+	return
+    }
+    Emit [list scenario $name items $N error "no such scenario"]
+    return
+}
@@ -0,0 +1,77 @@
+# display.tcl --
+#
+# Benchmarks for layout and drawing: scrolling page by page through the
+# whole list, redrawing everything and sizing columns to their contents.
+# These need a display. On a headless machine run them under Xvfb.
+#
+# See the file "license.terms" for information on usage and redistribution
+# of this file, and for a DISCLAIMER OF ALL WARRANTIES.
+
+bench::scenario scroll {
+    bench::Populate $T $N
+    $T yview moveto 0.0
+    update
+    bench::phase scroll-pages {
+	set pages 0
+	while {[lindex [$T yview] 1] < 1.0} {
+	    $T yview scroll 1 pages
+	    update idletasks
+	    incr pages
+	    if {$bench::Option(-maxpages) > 0 &&
+		$pages >= $bench::Option(-maxpages)} break
+	}
+	set pages
+    }
+    bench::phase scroll-units {
+	$T yview moveto 0.0
+	update idletasks
+	for {set i 0} {$i < 1000} {incr i} {
+	    $T yview scroll 1 units
+	    update idletasks
+	}
+	set i
+    }
+    bench::phase see-last {
+	$T see "last visible"
+	update idletasks
+    }
+}
+
+bench::scenario redraw {
+    bench::Populate $T $N
+    update
+    set bg [$T cget -background]
+    bench::phase redraw {
+	for {set i 0} {$i < 100} {incr i} {
+	    $T configure -background [expr {$i % 2 ? $bg : "white"}]
+	    update idletasks
+	}
+	set i
+    }
+    bench::phase itembackground {
+	for {set i 0} {$i < 100} {incr i} {
+	    $T column configure all -itembackground \
+		[expr {$i % 2 ? {} : {gray95 white}}]
+	    update idletasks
+	}
+	set i
+    }
+}
+
+bench::scenario autosize {
+    bench::Populate $T $N
+    update
+    bench::phase neededwidth {
+	$T column neededwidth C0
+	$T column neededwidth C1
+    }
+    bench::phase squeeze {
+	$T column configure all -width {} -squeeze yes
+	update idletasks
+    }
+    bench::phase font-change {
+	$T configure -font {Helvetica 14}
+	update idletasks
+	$T column neededwidth C0
+    }
+}
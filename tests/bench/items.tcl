@@ -0,0 +1,95 @@
+# items.tcl --
+#
+# Benchmarks for creating items and for commands that visit every item.
+#
+# See the file "license.terms" for information on usage and redistribution
+# of this file, and for a DISCLAIMER OF ALL WARRANTIES.
+
+bench::scenario create {
+    bench::phase create {
+	$T item create -count $N -parent root
+	set N
+    }
+    bench::phase text {
+	set i 0
+	foreach I [$T item children root] {
+	    $T item text $I C0 "Item $i" C1 $i
+	    incr i
+	}
+	set N
+    }
+    bench::phase delete {
+	$T item delete all
+	set N
+    }
+}
+
+bench::scenario expand {
+    set items [bench::Populate $T $N 9]
+    update
+    bench::phase expand-all {
+	$T item expand all
+	update idletasks
+	set N
+    }
+    bench::phase collapse-all {
+	$T item collapse all
+	update idletasks
+	set N
+    }
+    bench::phase expand-recurse {
+	$T item expand root -recurse
+	update idletasks
+	set N
+    }
+}
+
+bench::scenario selection {
+    bench::Populate $T $N
+    update
+    bench::phase add-all {
+	$T selection add all
+	set N
+    }
+    bench::phase count {
+	$T selection count
+    }
+    bench::phase clear {
+	$T selection clear
+	set N
+    }
+    bench::phase add-range {
+	$T selection add "first visible" "last visible"
+	set N
+    }
+}
+
+bench::scenario tags {
+    set items [bench::Populate $T $N]
+    bench::phase tag-add {
+	$T item tag add all item
+	set i 0
+	foreach I $items {
+	    if {$i % 10 == 0} {
+		$T item tag add $I ten
+	    }
+	    if {$i % 2} {
+		$T item tag add $I odd
+	    }
+	    incr i
+	}
+	expr {$N + $N / 10 + $N / 2}
+    }
+    bench::phase query-tag {
+	$T item count "tag ten"
+	set N
+    }
+    bench::phase query-expr {
+	$T item count "tag {ten && !odd}"
+	set N
+    }
+    bench::phase query-id {
+	llength [$T item id "tag odd"]
+	set N
+    }
+}
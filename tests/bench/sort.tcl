@@ -0,0 +1,38 @@
+# sort.tcl --
+#
+# Benchmarks for [item sort] in each comparison mode. The -command mode
+# calls a Tcl procedure for every comparison, so it only runs for lists
+# no bigger than the -commandmax option.
+#
+# See the file "license.terms" for information on usage and redistribution
+# of this file, and for a DISCLAIMER OF ALL WARRANTIES.
+
+proc bench::SortCommand {T I1 I2} {
+    return [expr {[$T item text $I1 C1] - [$T item text $I2 C1]}]
+}
+
+bench::scenario sort {
+    bench::Populate $T $N
+    foreach {mode column} {
+	-ascii C0 -dictionary C0 -integer C1 -real C1
+    } {
+	bench::phase [string range $mode 1 end] {
+	    $T item sort root -column $column $mode
+	    set N
+	}
+	bench::phase [string range $mode 1 end]-decreasing {
+	    $T item sort root -column $column $mode -decreasing
+	    set N
+	}
+	bench::phase [string range $mode 1 end]-notreally {
+	    $T item sort root -column $column $mode -notreally
+	    set N
+	}
+    }
+    if {$N <= $bench::Option(-commandmax)} {
+	bench::phase command {
+	    $T item sort root -column C1 -command [list bench::SortCommand $T]
+	    set N
+	}
+    }
+}